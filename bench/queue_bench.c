@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/traffic_simulation.h"
+
+// Microbenchmark: ring-buffer Queue versus the original malloc-per-node linked queue
+
+typedef struct LinkedNode {
+    Vehicle vehicle;
+    struct LinkedNode* next;
+} LinkedNode;
+
+typedef struct {
+    LinkedNode* front;
+    LinkedNode* rear;
+    int size;
+} LinkedQueue;
+
+void initLinkedQueue(LinkedQueue *q) {
+    q->front = q->rear = NULL;
+    q->size = 0;
+}
+
+void linkedEnqueue(LinkedQueue *q, Vehicle vehicle) {
+    LinkedNode *newNode = (LinkedNode *)malloc(sizeof(LinkedNode));
+    newNode->vehicle = vehicle;
+    newNode->next = NULL;
+    if (q->rear == NULL) {
+        q->front = q->rear = newNode;
+    } else {
+        q->rear->next = newNode;
+        q->rear = newNode;
+    }
+    q->size++;
+}
+
+Vehicle linkedDequeue(LinkedQueue *q) {
+    if (q->front == NULL) {
+        Vehicle emptyVehicle = {0};
+        return emptyVehicle;
+    }
+    LinkedNode *temp = q->front;
+    Vehicle vehicle = temp->vehicle;
+    q->front = q->front->next;
+    if (q->front == NULL) {
+        q->rear = NULL;
+    }
+    free(temp);
+    q->size--;
+    return vehicle;
+}
+
+// Vehicles are enqueued from a small pool of prebuilt samples, like spawned vehicles would be
+#define SAMPLE_COUNT 64
+Vehicle samples[SAMPLE_COUNT];
+
+double elapsedNs(Uint64 start) {
+    return (double)(SDL_GetPerformanceCounter() - start) * 1e9 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Steady state: the queue holds a few waiting vehicles while N arrive and N depart
+#define STEADY_DEPTH 32
+// Burst: N vehicles queue up before any depart, bounded to keep memory reasonable
+#define MAX_BURST_OPS 1000000
+
+double benchRingSteady(long ops, float *checksum) {
+    Queue q;
+    initQueue(&q);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (long i = 0; i < ops; i++) {
+        enqueue(&q, samples[i & (SAMPLE_COUNT - 1)]);
+        if (queueSize(&q) > STEADY_DEPTH) {
+            *checksum += dequeue(&q).x;
+        }
+    }
+    while (!isQueueEmpty(&q)) {
+        *checksum += dequeue(&q).x;
+    }
+    double ns = elapsedNs(start);
+    freeQueue(&q);
+    return ns;
+}
+
+double benchLinkedSteady(long ops, float *checksum) {
+    LinkedQueue q;
+    initLinkedQueue(&q);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (long i = 0; i < ops; i++) {
+        linkedEnqueue(&q, samples[i & (SAMPLE_COUNT - 1)]);
+        if (q.size > STEADY_DEPTH) {
+            *checksum += linkedDequeue(&q).x;
+        }
+    }
+    while (q.front != NULL) {
+        *checksum += linkedDequeue(&q).x;
+    }
+    return elapsedNs(start);
+}
+
+double benchRingBurst(long ops, float *checksum) {
+    Queue q;
+    initQueue(&q);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (long i = 0; i < ops; i++) {
+        enqueue(&q, samples[i & (SAMPLE_COUNT - 1)]);
+    }
+    while (!isQueueEmpty(&q)) {
+        *checksum += dequeue(&q).x;
+    }
+    double ns = elapsedNs(start);
+    freeQueue(&q);
+    return ns;
+}
+
+double benchLinkedBurst(long ops, float *checksum) {
+    LinkedQueue q;
+    initLinkedQueue(&q);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (long i = 0; i < ops; i++) {
+        linkedEnqueue(&q, samples[i & (SAMPLE_COUNT - 1)]);
+    }
+    while (q.front != NULL) {
+        *checksum += linkedDequeue(&q).x;
+    }
+    return elapsedNs(start);
+}
+
+int main(int argc, char *argv[]) {
+    float checksum = 0;
+
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        samples[i] = (Vehicle){0};
+        samples[i].x = (float)i;
+    }
+
+    printf("%-10s %-8s %14s %14s %8s\n", "ops", "pattern", "linked ns/op", "ring ns/op", "speedup");
+    for (long ops = 1000; ops <= 10000000; ops *= 10) {
+        double linkedNs = benchLinkedSteady(ops, &checksum);
+        double ringNs = benchRingSteady(ops, &checksum);
+        printf("%-10ld %-8s %14.2f %14.2f %7.2fx\n", ops, "steady", linkedNs / ops, ringNs / ops, linkedNs / ringNs);
+
+        if (ops <= MAX_BURST_OPS) {
+            linkedNs = benchLinkedBurst(ops, &checksum);
+            ringNs = benchRingBurst(ops, &checksum);
+            printf("%-10ld %-8s %14.2f %14.2f %7.2fx\n", ops, "burst", linkedNs / ops, ringNs / ops, linkedNs / ringNs);
+        }
+    }
+
+    // Printed so the compiler cannot discard the dequeued values
+    printf("checksum: %f\n", checksum);
+    return 0;
+}
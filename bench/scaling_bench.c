@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/traffic_simulation.h"
+
+// Benchmark: simulation frame time (lane index rebuild plus vehicle updates)
+// as the number of active vehicles grows. Every tick is a full simulationStep,
+// so the signals cycle as in a real run, and vehicles that leave are replaced
+// before the next tick, so each row runs at exactly its vehicle count.
+
+#define MIN_TICKS 3
+#define TARGET_VEHICLE_UPDATES 20000000L
+
+double countsToNs(Uint64 counts) {
+    return (double)counts * 1e9 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Spawns count vehicles and scatters them along their approach roads
+void populate(VehicleStore *store, int count, RandomStream *random) {
+    for (int i = 0; i < count; i++) {
+        int index = spawnVehicle(store, (Direction)randomBelow(random, 4), random);
+        if (store->direction[index] == DIRECTION_NORTH || store->direction[index] == DIRECTION_SOUTH) {
+            store->y[index] = (float)randomBelow(random, WINDOW_HEIGHT);
+        } else {
+            store->x[index] = (float)randomBelow(random, WINDOW_WIDTH);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long maxCount = (argc > 1) ? atol(argv[1]) : 10000000L;
+    RandomStream random;
+
+    seedRandomStream(&random, 12345, RANDOM_STREAM_BENCHMARK);
+    printf("%-10s %8s %14s %16s\n", "vehicles", "ticks", "ms/tick", "ns/vehicle");
+
+    for (long count = 100; count <= maxCount; count *= 10) {
+        Simulation sim;
+        initSimulation(&sim, (int)count, SIMULATION_TICK_MS);
+        sim.quiet = true;
+        populate(&sim.vehicles, (int)count, &random);
+
+        long ticks = TARGET_VEHICLE_UPDATES / count;
+        if (ticks < MIN_TICKS) {
+            ticks = MIN_TICKS;
+        }
+
+        long updates = 0;
+        StageTimings timings = {0};
+        for (long t = 0; t < ticks; t++) {
+            updates += sim.vehicles.count;
+            simulationStep(&sim, &timings);
+            // Untimed: top the population back up to count
+            populate(&sim.vehicles, (int)count - sim.vehicles.count, &random);
+        }
+        double ns = countsToNs(timings.laneIndex + timings.vehicles);
+
+        printf("%-10ld %8ld %14.3f %16.2f\n", count, ticks, ns / ticks / 1e6, ns / updates);
+
+        freeSimulation(&sim);
+    }
+
+    return 0;
+}
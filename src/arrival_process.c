@@ -0,0 +1,285 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arrival_process.h"
+
+#define NO_ARRIVAL DBL_MAX
+#define ARRIVAL_HORIZON_MS 4294967295.0
+
+// Matches the fixed spawner it replaces: one vehicle per second spread over the
+// four approaches, 15% emergency vehicles and 30% turning
+void defaultArrivalConfig(ArrivalConfig *config)
+{
+    memset(config, 0, sizeof(ArrivalConfig));
+    for (int i = 0; i < 4; i++)
+    {
+        config->vehiclesPerMinute[i] = 15.0f;
+    }
+    config->profileSegments = 0;
+    config->segmentMs = ARRIVAL_DEFAULT_SEGMENT_MS;
+    config->typeMix[REGULAR_CAR] = 85.0f;
+    config->typeMix[AMBULANCE] = 5.0f;
+    config->typeMix[POLICE_CAR] = 5.0f;
+    config->typeMix[FIRE_TRUCK] = 5.0f;
+    config->turnMix[TURN_NONE] = 70.0f;
+    config->turnMix[TURN_LEFT] = 15.0f;
+    config->turnMix[TURN_RIGHT] = 15.0f;
+}
+
+// Parses a comma-separated list of non-negative numbers, e.g. "10,20,5,5".
+// Returns the number of values, or -1 if the list is malformed or too long.
+int parseArrivalList(const char *text, float *values, int maxValues)
+{
+    int count = 0;
+    while (*text != '\0')
+    {
+        char *end;
+        float value = strtof(text, &end);
+        if (end == text || value < 0 || count == maxValues)
+        {
+            return -1;
+        }
+        values[count++] = value;
+        text = end;
+        if (*text == ',')
+        {
+            text++;
+        }
+        else if (*text != '\0')
+        {
+            return -1;
+        }
+    }
+    return count;
+}
+
+// Applies one command-line demand option. Returns 1 if it was applied, 0 if
+// the option is not a demand option and -1 if its value is invalid.
+int parseArrivalOption(ArrivalConfig *config, const char *option, const char *value)
+{
+    if (strcmp(option, "--rates") == 0)
+    {
+        return (parseArrivalList(value, config->vehiclesPerMinute, 4) == 4) ? 1 : -1;
+    }
+    if (strcmp(option, "--profile") == 0)
+    {
+        config->profileSegments = parseArrivalList(value, config->profile, ARRIVAL_PROFILE_MAX_SEGMENTS);
+        return (config->profileSegments > 0) ? 1 : -1;
+    }
+    if (strcmp(option, "--profile-segment") == 0)
+    {
+        double seconds = atof(value);
+        config->segmentMs = (Uint32)(seconds * 1000.0);
+        return (config->segmentMs > 0) ? 1 : -1;
+    }
+    if (strcmp(option, "--type-mix") == 0)
+    {
+        return (parseArrivalList(value, config->typeMix, 4) == 4) ? 1 : -1;
+    }
+    if (strcmp(option, "--turn-mix") == 0)
+    {
+        return (parseArrivalList(value, config->turnMix, 3) == 3) ? 1 : -1;
+    }
+    return 0;
+}
+
+// Turns relative weights into the n-1 inner cumulative thresholds
+static void buildCdf(const float *weights, int n, float *cdf)
+{
+    float total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        total += weights[i];
+    }
+    float sum = 0;
+    for (int i = 0; i < n - 1; i++)
+    {
+        sum += weights[i];
+        cdf[i] = (total > 0) ? sum / total : 1.0f;
+    }
+}
+
+static void refillGaps(ArrivalProcess *process, int approach)
+{
+    float *gaps = process->gaps[approach];
+    fillRandomFloats(&process->gapStreams[approach], gaps, ARRIVAL_SAMPLE_BATCH);
+    // Kept apart from the draws so the transform runs as one tight loop
+    for (int i = 0; i < ARRIVAL_SAMPLE_BATCH; i++)
+    {
+        gaps[i] = -logf(gaps[i]);
+    }
+    process->gapIndex[approach] = 0;
+}
+
+static float profileMultiplier(const ArrivalConfig *config, double time)
+{
+    if (config->profileSegments == 0)
+    {
+        return 1.0f;
+    }
+    Uint64 segment = (Uint64)(time / config->segmentMs);
+    return config->profile[segment % config->profileSegments];
+}
+
+// Time of the approach's next arrival after `time`. The unit-rate gap is spent
+// against the integrated rate, segment by segment, so arrivals follow the
+// time-varying rate exactly instead of the rate at the previous arrival.
+static double advanceArrival(ArrivalProcess *process, int approach, double time)
+{
+    const ArrivalConfig *config = &process->config;
+    double baseRate = config->vehiclesPerMinute[approach] / 60000.0; // Vehicles per ms
+
+    if (process->gapIndex[approach] == ARRIVAL_SAMPLE_BATCH)
+    {
+        refillGaps(process, approach);
+    }
+    double gap = process->gaps[approach][process->gapIndex[approach]++];
+
+    while (1)
+    {
+        double rate = baseRate * profileMultiplier(config, time);
+        if (config->profileSegments == 0)
+        {
+            return time + gap / rate;
+        }
+        double segmentEnd = (floor(time / config->segmentMs) + 1.0) * config->segmentMs;
+        double capacity = rate * (segmentEnd - time);
+        if (gap <= capacity)
+        {
+            return time + gap / rate;
+        }
+        gap -= capacity;
+        time = segmentEnd;
+    }
+}
+
+// Processes built from the same configuration and seed produce identical arrivals
+void initArrivalProcess(ArrivalProcess *process, const ArrivalConfig *config, Uint64 seed)
+{
+    memset(process, 0, sizeof(ArrivalProcess));
+    process->config = *config;
+    if (process->config.segmentMs == 0)
+    {
+        process->config.segmentMs = ARRIVAL_DEFAULT_SEGMENT_MS;
+    }
+    buildCdf(config->typeMix, 4, process->typeCdf);
+    buildCdf(config->turnMix, 3, process->turnCdf);
+
+    // A profile that is zero everywhere would never let an arrival through
+    float profileTotal = 0;
+    for (int i = 0; i < config->profileSegments; i++)
+    {
+        profileTotal += config->profile[i];
+    }
+    bool silent = config->profileSegments > 0 && profileTotal <= 0;
+
+    seedRandomStream(&process->mixStream, seed, RANDOM_STREAM_VEHICLE_MIX);
+    for (int i = 0; i < 4; i++)
+    {
+        seedRandomStream(&process->gapStreams[i], seed, RANDOM_STREAM_ARRIVALS + i);
+        process->gapIndex[i] = ARRIVAL_SAMPLE_BATCH;
+        if (silent || config->vehiclesPerMinute[i] <= 0)
+        {
+            process->nextArrival[i] = NO_ARRIVAL;
+        }
+        else
+        {
+            process->nextArrival[i] = advanceArrival(process, i, 0.0);
+        }
+    }
+}
+
+// Produces the next `count` arrivals across all approaches in time order.
+// Returns fewer only when there is no demand or the arrivals would run past the
+// ~49 days a millisecond timestamp can represent.
+int generateArrivals(ArrivalProcess *process, SpawnRecord *records, int count)
+{
+    // Merge the four approach streams; only the times depend on each other
+    int generated = 0;
+    while (generated < count)
+    {
+        int approach = 0;
+        for (int i = 1; i < 4; i++)
+        {
+            if (process->nextArrival[i] < process->nextArrival[approach])
+            {
+                approach = i;
+            }
+        }
+        double time = process->nextArrival[approach];
+        if (time > ARRIVAL_HORIZON_MS)
+        {
+            break; // No demand, or past what a SpawnRecord timestamp can hold
+        }
+        records[generated].timestamp = (Uint32)time;
+        records[generated].direction = (Uint8)approach;
+        process->nextArrival[approach] = advanceArrival(process, approach, time);
+        generated++;
+    }
+
+    // Types and turns are independent of timing, so they are drawn a batch at a
+    // time and mapped through the mixes without branches
+    float typeRolls[ARRIVAL_SAMPLE_BATCH];
+    float turnRolls[ARRIVAL_SAMPLE_BATCH];
+    for (int start = 0; start < generated; start += ARRIVAL_SAMPLE_BATCH)
+    {
+        int batch = (generated - start < ARRIVAL_SAMPLE_BATCH) ? generated - start : ARRIVAL_SAMPLE_BATCH;
+        fillRandomFloats(&process->mixStream, typeRolls, batch);
+        fillRandomFloats(&process->mixStream, turnRolls, batch);
+        SpawnRecord *batchRecords = records + start;
+        for (int i = 0; i < batch; i++)
+        {
+            Uint8 type = (typeRolls[i] > process->typeCdf[0]) + (typeRolls[i] > process->typeCdf[1]) +
+                         (typeRolls[i] > process->typeCdf[2]);
+            Uint8 turn = (turnRolls[i] > process->turnCdf[0]) + (turnRolls[i] > process->turnCdf[1]);
+            batchRecords[i].type = type;
+            batchRecords[i].turnDirection = turn;
+            batchRecords[i].lane = (turn == TURN_RIGHT) ? 1 : 0;
+        }
+    }
+    return generated;
+}
+
+// Next arrival in time order, generated a batch at a time; NULL if there is no demand
+const SpawnRecord *peekArrival(ArrivalProcess *process)
+{
+    if (process->upcomingNext == process->upcomingCount)
+    {
+        process->upcomingCount = generateArrivals(process, process->upcoming, ARRIVAL_SAMPLE_BATCH);
+        process->upcomingNext = 0;
+        if (process->upcomingCount == 0)
+        {
+            return NULL;
+        }
+    }
+    return &process->upcoming[process->upcomingNext];
+}
+
+void consumeArrival(ArrivalProcess *process)
+{
+    process->upcomingNext++;
+}
+
+// Drops the arrivals before `time`, e.g. when a run starts part way through the demand
+void skipArrivalsBefore(ArrivalProcess *process, Uint32 time)
+{
+    const SpawnRecord *arrival;
+    while ((arrival = peekArrival(process)) != NULL && arrival->timestamp < time)
+    {
+        consumeArrival(process);
+    }
+}
+
+// Spawns the arrivals that are due. An arrival that does not fit waits at the
+// entrance for the next tick.
+void drainArrivals(ArrivalProcess *process, Simulation *sim, Uint32 now)
+{
+    const SpawnRecord *arrival;
+    while ((arrival = peekArrival(process)) != NULL && arrival->timestamp <= now &&
+           spawnVehicleFromRecord(sim, arrival) >= 0)
+    {
+        sim->stats.totalVehicles++;
+        consumeArrival(process);
+    }
+}
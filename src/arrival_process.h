@@ -0,0 +1,51 @@
+#ifndef ARRIVAL_PROCESS_H
+#define ARRIVAL_PROCESS_H
+
+#include "traffic_simulation.h"
+
+// Vehicle demand: an independent Poisson process per approach whose rate is
+// scaled by a cyclic time-of-day profile, plus type and turn mixes.
+#define ARRIVAL_PROFILE_MAX_SEGMENTS 48
+#define ARRIVAL_SAMPLE_BATCH 256          // Random variates drawn per refill
+#define ARRIVAL_DEFAULT_SEGMENT_MS 3600000 // One profile entry per simulated hour
+
+typedef struct {
+    float vehiclesPerMinute[4]; // Base demand per approach, indexed by Direction
+    float profile[ARRIVAL_PROFILE_MAX_SEGMENTS]; // Rate multipliers, repeated cyclically
+    int profileSegments; // 0 means a constant rate
+    Uint32 segmentMs;
+    float typeMix[4]; // Relative weights, indexed by VehicleType
+    float turnMix[3]; // Relative weights, indexed by TurnDirection
+} ArrivalConfig;
+
+typedef struct {
+    ArrivalConfig config;
+    double nextArrival[4]; // Simulated ms of each approach's next arrival
+    float gaps[4][ARRIVAL_SAMPLE_BATCH]; // Unit-rate exponential gaps, used front to back
+    int gapIndex[4];
+    float typeCdf[3];
+    float turnCdf[2];
+    RandomStream gapStreams[4]; // Each approach draws from its own stream
+    RandomStream mixStream;
+    SpawnRecord upcoming[ARRIVAL_SAMPLE_BATCH]; // Generated ahead for peekArrival
+    int upcomingNext;
+    int upcomingCount;
+} ArrivalProcess;
+
+void defaultArrivalConfig(ArrivalConfig* config);
+int parseArrivalList(const char* text, float* values, int maxValues);
+int parseArrivalOption(ArrivalConfig* config, const char* option, const char* value);
+
+void initArrivalProcess(ArrivalProcess* process, const ArrivalConfig* config, Uint64 seed);
+int generateArrivals(ArrivalProcess* process, SpawnRecord* records, int count);
+
+// One-at-a-time access for spawning; do not mix with generateArrivals
+const SpawnRecord* peekArrival(ArrivalProcess* process);
+void consumeArrival(ArrivalProcess* process);
+void skipArrivalsBefore(ArrivalProcess* process, Uint32 time);
+void drainArrivals(ArrivalProcess* process, Simulation* sim, Uint32 now);
+
+#define ARRIVAL_OPTIONS_USAGE "[--rates <n,s,e,w per min>] [--profile <m1,m2,...>] [--profile-segment <s>] " \
+                              "[--type-mix <car,ambulance,police,fire>] [--turn-mix <straight,left,right>]"
+
+#endif
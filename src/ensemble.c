@@ -0,0 +1,103 @@
+#include <math.h>
+#include <string.h>
+#include "ensemble.h"
+#include "work_pool.h"
+
+typedef struct {
+    const ReplicaSpec *specs;
+    Statistics *results;
+} EnsembleBatch;
+
+// Runs one replica from an empty intersection for its duration, jumping over
+// idle ticks; the result is the same as running every tick
+void runReplica(const ReplicaSpec *spec, Statistics *result)
+{
+    Simulation sim;
+    ArrivalProcess arrivals;
+    initSimulation(&sim, spec->maxVehicles, SIMULATION_TICK_MS);
+    sim.parameters = spec->parameters;
+    sim.quiet = true;
+    initArrivalProcess(&arrivals, &spec->arrivals, spec->seed);
+
+    while (sim.clock.now < spec->durationMs)
+    {
+        drainArrivals(&arrivals, &sim, sim.clock.now);
+        simulationStep(&sim, NULL);
+
+        const SpawnRecord *next = peekArrival(&arrivals);
+        Uint32 nextEvent = (next != NULL && next->timestamp < spec->durationMs) ? next->timestamp : spec->durationMs;
+        skipIdleTicks(&sim, nextEvent);
+    }
+
+    *result = sim.stats;
+    freeSimulation(&sim);
+}
+
+static void runBatchReplica(void *context, int task)
+{
+    EnsembleBatch *batch = (EnsembleBatch *)context;
+    runReplica(&batch->specs[task], &batch->results[task]);
+}
+
+// Runs every replica, spread over workerCount threads; results[i] belongs to specs[i]
+void runEnsemble(const ReplicaSpec *specs, Statistics *results, int count, int workerCount)
+{
+    EnsembleBatch batch = {specs, results};
+    runWorkPool(count, workerCount, runBatchReplica, &batch);
+}
+
+static void addMetricSample(EnsembleMetric *metric, double value, int index)
+{
+    // Welford's update, stable however many replicas are added
+    double delta = value - metric->mean;
+    metric->mean += delta / (index + 1);
+    metric->m2 += delta * (value - metric->mean);
+    if (index == 0 || value < metric->min)
+    {
+        metric->min = value;
+    }
+    if (index == 0 || value > metric->max)
+    {
+        metric->max = value;
+    }
+}
+
+// Sample standard deviation
+double metricStddev(const EnsembleMetric *metric, int count)
+{
+    return (count > 1) ? sqrt(metric->m2 / (count - 1)) : 0;
+}
+
+// Half-width of the 95% confidence interval of the mean, from Student's t
+double metricConfidence(const EnsembleMetric *metric, int count)
+{
+    static const double T_975[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (count < 2)
+    {
+        return HUGE_VAL;
+    }
+    int degrees = count - 1;
+    double t = (degrees <= 30) ? T_975[degrees - 1] : (degrees <= 60) ? 2.000 : 1.960;
+    return t * metricStddev(metric, count) / sqrt((double)count);
+}
+
+void addEnsembleResult(EnsembleSummary *summary, const Statistics *result)
+{
+    int index = summary->replicas++;
+    addMetricSample(&summary->vehiclesPassed, result->vehiclesPassed, index);
+    addMetricSample(&summary->totalVehicles, result->totalVehicles, index);
+    addMetricSample(&summary->vehiclesPerMinute, result->vehiclesPerMinute, index);
+    addMetricSample(&summary->meanWait, meanWait(&result->waits), index);
+    mergeWaitHistograms(&summary->waits, &result->waits);
+}
+
+void summarizeEnsemble(const Statistics *results, int count, EnsembleSummary *summary)
+{
+    memset(summary, 0, sizeof(EnsembleSummary));
+    for (int i = 0; i < count; i++)
+    {
+        addEnsembleResult(summary, &results[i]);
+    }
+}
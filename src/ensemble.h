@@ -0,0 +1,43 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "traffic_simulation.h"
+#include "arrival_process.h"
+
+// Batches of independent headless replicas of a scenario, run on a work pool.
+// Every replica owns its simulation and arrival process and nothing is shared,
+// so the results do not depend on the number of threads.
+typedef struct {
+    SimulationParameters parameters;
+    ArrivalConfig arrivals;
+    Uint64 seed;
+    int maxVehicles;
+    Uint32 durationMs;
+} ReplicaSpec;
+
+// Spread of one per-replica value across the ensemble
+typedef struct {
+    double mean;
+    double m2; // Sum of squared deviations from the mean
+    double min;
+    double max;
+} EnsembleMetric;
+
+typedef struct {
+    int replicas;
+    EnsembleMetric vehiclesPassed;
+    EnsembleMetric totalVehicles;
+    EnsembleMetric vehiclesPerMinute;
+    EnsembleMetric meanWait; // Seconds
+    WaitHistogram waits;     // Every vehicle of every replica
+} EnsembleSummary;
+
+void runReplica(const ReplicaSpec* spec, Statistics* result);
+void runEnsemble(const ReplicaSpec* specs, Statistics* results, int count, int workerCount);
+void summarizeEnsemble(const Statistics* results, int count, EnsembleSummary* summary);
+void addEnsembleResult(EnsembleSummary* summary, const Statistics* result);
+
+double metricStddev(const EnsembleMetric* metric, int count);
+double metricConfidence(const EnsembleMetric* metric, int count);
+
+#endif
@@ -1,47 +1,240 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "traffic_simulation.h"
+#include "vehicle_channel.h"
+#include "vehicle_trace.h"
+#include "arrival_process.h"
 
-void writeVehicleToFile(FILE *file, Vehicle *vehicle)
+#define DEFAULT_INTERVAL_MS 2000
+#define CHANNEL_BATCH_SIZE 256
+#define DEFAULT_TRACE_PATH "bin/vehicles.trace"
+#define TRACE_BATCH_SIZE 4096
+#define STREAM_FLUSH_MS 100
+
+// Writes a trace of exactly count arrivals as fast as possible
+int runBulkTraceGenerator(TraceWriter *writer, ArrivalProcess *arrivals, Uint64 count)
 {
-    fprintf(file, "%f %f %d %d %d %d %d %d\n",
-            vehicle->x, vehicle->y,
-            vehicle->direction,
-            vehicle->type,
-            vehicle->turnDirection,
-            vehicle->state,
-            vehicle->speed,
-            vehicle->canSkipLight);
+    SpawnRecord batch[TRACE_BATCH_SIZE];
+    Uint32 lastTimestamp = 0;
+    Uint64 generated = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    while (generated < count)
+    {
+        int wanted = (count - generated < TRACE_BATCH_SIZE) ? (int)(count - generated) : TRACE_BATCH_SIZE;
+        int batchCount = generateArrivals(arrivals, batch, wanted);
+        if (batchCount == 0)
+        {
+            break; // No demand configured
+        }
+        if (!writeTraceRecords(writer, batch, batchCount))
+        {
+            perror("Failed to write the vehicle trace");
+            return 1;
+        }
+        lastTimestamp = batch[batchCount - 1].timestamp;
+        generated += batchCount;
+    }
+    if (!flushTraceWriter(writer))
+    {
+        perror("Failed to write the vehicle trace");
+        return 1;
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    printf("Generated %llu vehicles covering %.1f simulated s in %.1f ms\n", (unsigned long long)generated,
+           lastTimestamp / 1000.0, seconds * 1000.0);
+    return 0;
 }
 
-int SDL_main(int argc, char *argv[])
+// Writes arrivals in real time. Arrivals that fall due within a flush period
+// go out together instead of one write per vehicle.
+int runStreamingTraceGenerator(TraceWriter *writer, ArrivalProcess *arrivals)
 {
-    srand(time(NULL));
-    FILE *file = fopen("bin/vehicles.txt", "w");
-    if (!file)
+    SpawnRecord batch[TRACE_BATCH_SIZE];
+    int next = 0;
+    int count = 0;
+    Uint32 start = SDL_GetTicks();
+
+    while (1)
+    {
+        Uint32 elapsed = SDL_GetTicks() - start;
+        while (1)
+        {
+            if (next == count)
+            {
+                count = generateArrivals(arrivals, batch, TRACE_BATCH_SIZE);
+                next = 0;
+                if (count == 0)
+                {
+                    break;
+                }
+            }
+            int due = next;
+            while (due < count && batch[due].timestamp <= elapsed)
+            {
+                due++;
+            }
+            if (due > next && !writeTraceRecords(writer, batch + next, due - next))
+            {
+                perror("Failed to write the vehicle trace");
+                return 1;
+            }
+            bool caughtUp = due < count;
+            next = due;
+            if (caughtUp)
+            {
+                break;
+            }
+        }
+
+        // Make this period's arrivals visible to a simulator replaying the file;
+        // it remaps the trace once it has consumed what it mapped before
+        if (!flushTraceWriter(writer))
+        {
+            perror("Failed to write the vehicle trace");
+            return 1;
+        }
+        SDL_Delay(STREAM_FLUSH_MS);
+    }
+    return 0;
+}
+
+// Writes a binary trace that the simulator replays with --trace. A count of 0
+// streams arrivals in real time; otherwise count arrivals are generated in bulk.
+int runTraceGenerator(const char *path, const ArrivalConfig *config, Uint64 count, Uint64 seed)
+{
+    TraceWriter writer;
+    if (!openTraceWriter(&writer, path))
     {
-        perror("Failed to open vehicles.txt");
+        perror("Failed to open the vehicle trace");
         return 1;
     }
 
+    ArrivalProcess arrivals;
+    initArrivalProcess(&arrivals, config, seed);
+    int result = (count > 0) ? runBulkTraceGenerator(&writer, &arrivals, count)
+                             : runStreamingTraceGenerator(&writer, &arrivals);
+    closeTraceWriter(&writer);
+    return result;
+}
+
+// Publishes vehicles into the shared-memory channel read by the simulator.
+// With an interval of 0 vehicles are produced in batches as fast as possible.
+int runChannelGenerator(Uint32 intervalMs, Uint64 seed)
+{
+    VehicleChannel channel;
+    if (!createVehicleChannel(&channel, VEHICLE_CHANNEL_NAME))
+    {
+        perror("Failed to create the vehicle channel");
+        return 1;
+    }
+
+    SpawnRecord batch[CHANNEL_BATCH_SIZE];
+    RandomStream random;
+    seedRandomStream(&random, seed, RANDOM_STREAM_GENERATOR);
+    Uint32 start = SDL_GetTicks();
+    Uint32 lastReport = start;
+    Uint64 generated = 0;
+
     while (1)
     {
-        // Generate a new vehicle
-        Direction spawnDirection = (Direction)(rand() % 4);
-        Vehicle *newVehicle = createVehicle(spawnDirection);
+        Uint32 timestamp = SDL_GetTicks() - start;
+        int count = (intervalMs == 0) ? CHANNEL_BATCH_SIZE : 1;
+        for (int i = 0; i < count; i++)
+        {
+            Vehicle vehicle;
+            initVehicle(&vehicle, (Direction)randomBelow(&random, 4), &random);
+            makeSpawnRecord(&batch[i], &vehicle, timestamp);
+        }
 
-        // Write the vehicle data to the file
-        writeVehicleToFile(file, newVehicle);
-        fflush(file); // Ensure data is written to the file immediately
+        int written = 0;
+        while (written < count)
+        {
+            written += writeVehicleChannel(&channel, batch + written, count - written);
+            if (written < count)
+            {
+                SDL_Delay(1); // Ring is full; give the simulator time to drain it
+            }
+        }
+        generated += count;
 
-        // Free the vehicle memory
-        free(newVehicle);
+        Uint32 now = SDL_GetTicks();
+        if (now - lastReport >= 1000)
+        {
+            printf("Generated %llu vehicles (%.0f vehicles/s)\n", (unsigned long long)generated,
+                   generated * 1000.0 / (now - start));
+            lastReport = now;
+        }
 
-        // Wait for a short period before generating the next vehicle
-        SDL_Delay(2000); // 2 seconds delay
+        if (intervalMs > 0)
+        {
+            SDL_Delay(intervalMs);
+        }
     }
 
-    fclose(file);
+    closeVehicleChannel(&channel);
     return 0;
-}
\ No newline at end of file
+}
+
+int SDL_main(int argc, char *argv[])
+{
+    bool useChannel = false;
+    bool hasInterval = false;
+    Uint32 intervalMs = DEFAULT_INTERVAL_MS;
+    const char *tracePath = DEFAULT_TRACE_PATH;
+    Uint64 count = 0;
+    Uint64 seed = (Uint64)time(NULL);
+    ArrivalConfig arrivals;
+    defaultArrivalConfig(&arrivals);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--channel") == 0)
+        {
+            useChannel = true;
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            intervalMs = (Uint32)strtoul(argv[++i], NULL, 10);
+            hasInterval = true;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+        {
+            count = strtoull(argv[++i], NULL, 10);
+        }
+        else if (i + 1 < argc && parseArrivalOption(&arrivals, argv[i], argv[i + 1]) > 0)
+        {
+            i++;
+        }
+        else
+        {
+            printf("Usage: %s --channel [--interval <ms>] [--seed <n>]\n"
+                   "       %s [--trace <file>] [--count <n>] [--seed <n>] " ARRIVAL_OPTIONS_USAGE "\n",
+                   argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if (useChannel)
+    {
+        return runChannelGenerator(intervalMs, seed);
+    }
+    if (hasInterval)
+    {
+        // Trace arrivals follow the arrival rates, not a fixed interval
+        fprintf(stderr, "--interval only applies to --channel; set trace demand with --rates or --profile\n");
+        return 1;
+    }
+    return runTraceGenerator(tracePath, &arrivals, count, seed);
+}
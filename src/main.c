@@ -1,7 +1,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 #include "traffic_simulation.h"
+#include "vehicle_channel.h"
+#include "vehicle_trace.h"
+#include "arrival_process.h"
+#include "run_log.h"
+#include "snapshot.h"
+#include "ensemble.h"
+#include "work_pool.h"
+
+#define FRAME_DELAY_MS 16
+
+typedef struct {
+    bool headless;
+    float durationSeconds;
+    int ticksPerFrame;
+    Uint64 seed;
+    bool hasSeed;
+    int maxVehicles;
+    bool useChannel;
+    const char *tracePath;
+    const char *recordPath;
+    const char *replayPath;
+    float replayFromSeconds;
+    const char *loadSnapshotPath;
+    const char *saveSnapshotPath;
+    int replicas;
+    int threads;
+    bool timeStepped;
+    ArrivalConfig arrivals;
+} SimulationOptions;
+
+// Where new vehicles come from: the built-in arrival process, the generator's
+// shared-memory channel, a pre-recorded binary trace or a run being replayed
+typedef struct {
+    VehicleChannel *channel;
+    TraceReader *trace;
+    RunReplay *replay;
+    ArrivalProcess arrivals;
+} VehicleSource;
 
 void initializeSDL(SDL_Window **window, SDL_Renderer **renderer) {
     SDL_Init(SDL_INIT_VIDEO);
@@ -25,130 +64,438 @@ void handleEvents(bool *running) {
     }
 }
 
-Vehicle readVehicleFromFire(FILE *file) {
-    Vehicle vehicle = {0};
-    if (fscanf(file, "%f %f %d %d %d %d %d %d", 
-           &vehicle.x, &vehicle.y, 
-           (int*)&vehicle.direction, 
-           (int*)&vehicle.type, 
-           (int*)&vehicle.turnDirection, 
-           (int*)&vehicle.state, 
-           (int*)&vehicle.canSkipLight,
-           &vehicle.speed) == 7) {
-        vehicle.active = true;
-        
-        // Set dimensions based on direction
-        if (vehicle.direction == DIRECTION_NORTH || vehicle.direction == DIRECTION_SOUTH) {
-            vehicle.rect.w = 20;
-            vehicle.rect.h = 30;
+// Returns false if the recording could not be written in full
+bool cleanupSimulation(Simulation *sim, VehicleSource *source, RunRecorder *recorder) {
+    bool recorded = true;
+    if (recorder != NULL) {
+        recorded = closeRunRecorder(recorder);
+    }
+    if (source->channel != NULL) {
+        closeVehicleChannel(source->channel);
+    }
+    if (source->trace != NULL) {
+        closeTraceReader(source->trace);
+    }
+    if (source->replay != NULL) {
+        closeRunReplay(source->replay);
+    }
+    freeSimulation(sim);
+    return recorded;
+}
+
+void printStageTimings(const StageTimings *timings, Uint32 ticks) {
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    double total = (double)(timings->laneIndex + timings->signals + timings->vehicles + timings->statistics);
+    if (ticks == 0 || total == 0) {
+        return;
+    }
+    printf("Average per tick: lane index %.2f us, signals %.2f us, vehicles %.2f us, statistics %.2f us\n",
+           timings->laneIndex * 1e6 / frequency / ticks, timings->signals * 1e6 / frequency / ticks,
+           timings->vehicles * 1e6 / frequency / ticks, timings->statistics * 1e6 / frequency / ticks);
+}
+
+void printWaitTimes(const WaitHistogram *waits) {
+    printf("Wait per vehicle: mean %.2f s, median %.0f s, 90th percentile %.0f s, 99th percentile %.0f s, max %.1f s\n",
+           meanWait(waits), waitPercentile(waits, 0.5), waitPercentile(waits, 0.9), waitPercentile(waits, 0.99),
+           waits->maxMs / 1000.0);
+}
+
+void printEnsembleMetric(const char *name, const EnsembleMetric *metric, int count) {
+    printf("%-18s %10.2f %10.2f %10.2f %10.2f\n", name, metric->mean, metricStddev(metric, count), metric->min, metric->max);
+}
+
+// Runs --replicas independent copies of the scenario, each with a seed derived
+// from the base seed, and reports the spread of their results
+int runEnsembleMode(const SimulationOptions *options) {
+    int workers = (options->threads > 0) ? options->threads : defaultWorkerCount();
+    ReplicaSpec *specs = (ReplicaSpec *)malloc(options->replicas * sizeof(ReplicaSpec));
+    Statistics *results = (Statistics *)malloc(options->replicas * sizeof(Statistics));
+    if (specs == NULL || results == NULL) {
+        free(specs);
+        free(results);
+        return 1;
+    }
+    for (int i = 0; i < options->replicas; i++) {
+        defaultSimulationParameters(&specs[i].parameters);
+        specs[i].arrivals = options->arrivals;
+        specs[i].seed = deriveSeed(options->seed, (Uint64)i);
+        specs[i].maxVehicles = options->maxVehicles;
+        specs[i].durationMs = (Uint32)(options->durationSeconds * 1000.0f);
+    }
+
+    Uint64 wallStart = SDL_GetPerformanceCounter();
+    runEnsemble(specs, results, options->replicas, workers);
+    double wallSeconds = (double)(SDL_GetPerformanceCounter() - wallStart) / SDL_GetPerformanceFrequency();
+
+    EnsembleSummary summary;
+    summarizeEnsemble(results, options->replicas, &summary);
+    printf("Ran %d replicas of %.1f s (seed %llu) on %d threads in %.2f s wall time\n",
+           options->replicas, options->durationSeconds, (unsigned long long)options->seed,
+           (workers < options->replicas) ? workers : options->replicas, wallSeconds);
+    printf("%-18s %10s %10s %10s %10s\n", "", "mean", "stddev", "min", "max");
+    printEnsembleMetric("Vehicles spawned", &summary.totalVehicles, summary.replicas);
+    printEnsembleMetric("Vehicles passed", &summary.vehiclesPassed, summary.replicas);
+    printEnsembleMetric("Vehicles/min", &summary.vehiclesPerMinute, summary.replicas);
+    printEnsembleMetric("Mean wait (s)", &summary.meanWait, summary.replicas);
+    printWaitTimes(&summary.waits);
+
+    free(specs);
+    free(results);
+    return 0;
+}
+
+void printUsage(const char *program) {
+    printf("Usage: %s [--headless <simulated seconds>] [--speed <ticks per frame>] [--seed <n>] [--max-vehicles <n>] [--channel | --trace <file>]\n"
+           "       [--record <file>] [--replay <file> [--from <simulated seconds>]]\n"
+           "       [--load-snapshot <file>] [--save-snapshot <file>] [--replicas <n> [--threads <n>]] [--time-stepped]\n"
+           "       " ARRIVAL_OPTIONS_USAGE "\n", program);
+}
+
+bool parseArguments(int argc, char *argv[], SimulationOptions *options) {
+    options->headless = false;
+    options->durationSeconds = 0;
+    options->ticksPerFrame = 1;
+    options->seed = 0;
+    options->hasSeed = false;
+    options->maxVehicles = DEFAULT_MAX_VEHICLES;
+    options->useChannel = false;
+    options->tracePath = NULL;
+    options->recordPath = NULL;
+    options->replayPath = NULL;
+    options->replayFromSeconds = 0;
+    options->loadSnapshotPath = NULL;
+    options->saveSnapshotPath = NULL;
+    options->replicas = 0;
+    options->threads = 0;
+    options->timeStepped = false;
+    defaultArrivalConfig(&options->arrivals);
+
+    int demandOption;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            options->headless = true;
+            options->durationSeconds = (float)atof(argv[++i]);
+            if (options->durationSeconds <= 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            options->ticksPerFrame = atoi(argv[++i]);
+            if (options->ticksPerFrame <= 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+            options->hasSeed = true;
+        } else if (strcmp(argv[i], "--max-vehicles") == 0 && i + 1 < argc) {
+            options->maxVehicles = atoi(argv[++i]);
+            if (options->maxVehicles <= 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--channel") == 0) {
+            options->useChannel = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options->tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options->recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            options->replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            options->replayFromSeconds = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--load-snapshot") == 0 && i + 1 < argc) {
+            options->loadSnapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc) {
+            options->saveSnapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--time-stepped") == 0) {
+            options->timeStepped = true;
+        } else if (strcmp(argv[i], "--replicas") == 0 && i + 1 < argc) {
+            options->replicas = atoi(argv[++i]);
+            if (options->replicas <= 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->threads = atoi(argv[++i]);
+            if (options->threads <= 0) {
+                return false;
+            }
+        } else if (i + 1 < argc && (demandOption = parseArrivalOption(&options->arrivals, argv[i], argv[i + 1])) != 0) {
+            if (demandOption < 0) {
+                return false;
+            }
+            i++;
         } else {
-            vehicle.rect.w = 30;
-            vehicle.rect.h = 20;
+            return false;
+        }
+    }
+    int sources = (options->useChannel ? 1 : 0) + (options->tracePath != NULL ? 1 : 0) + (options->replayPath != NULL ? 1 : 0);
+    if (options->replicas > 0) {
+        // Replicas are headless runs of the built-in arrival process from an empty intersection
+        return options->headless && sources == 0 && options->recordPath == NULL &&
+               options->loadSnapshotPath == NULL && options->saveSnapshotPath == NULL;
+    }
+    // A replay starts from the snapshots embedded in its recording
+    return sources <= 1 && !(options->replayPath != NULL && options->loadSnapshotPath != NULL);
+}
+
+// Spawns every vehicle the generator has published up to the current time,
+// reading the records in place. Records that do not fit stay in the channel.
+void drainVehicleChannel(VehicleChannel *channel, Simulation *sim, Uint32 now) {
+    const SpawnRecord *records;
+    int available;
+    while ((available = peekVehicleChannel(channel, &records)) > 0) {
+        int used = 0;
+        while (used < available && records[used].timestamp <= now &&
+               spawnVehicleFromRecord(sim, &records[used]) >= 0) {
+            sim->stats.totalVehicles++;
+            used++;
+        }
+        consumeVehicleChannel(channel, used);
+        if (used < available) {
+            break;
+        }
+    }
+}
+
+// Spawns the trace records that are due, straight out of the mapped file.
+// A record that does not fit is retried on the next tick. Once every mapped
+// record is spawned, records the generator has appended since are picked up.
+void drainVehicleTrace(TraceReader *trace, Simulation *sim, Uint32 now) {
+    if (trace->next == trace->count) {
+        refreshTraceReader(trace);
+    }
+    while (trace->next < trace->count && trace->records[trace->next].timestamp <= now &&
+           spawnVehicleFromRecord(sim, &trace->records[trace->next]) >= 0) {
+        sim->stats.totalVehicles++;
+        trace->next++;
+    }
+}
+
+// Returns when the next vehicle is due from the source, or `end` if that is
+// earlier. A channel's vehicles are not known in advance, so it is always due.
+Uint32 nextVehicleEvent(VehicleSource *source, Uint32 now, Uint32 end) {
+    Uint32 next = end;
+    if (source->channel != NULL) {
+        next = now;
+    } else if (source->trace != NULL) {
+        if (source->trace->next < source->trace->count) {
+            next = source->trace->records[source->trace->next].timestamp;
+        }
+    } else if (source->replay == NULL) {
+        const SpawnRecord *arrival = peekArrival(&source->arrivals);
+        if (arrival != NULL) {
+            next = arrival->timestamp;
         }
-        
-        vehicle.rect.x = (int)vehicle.x;
-        vehicle.rect.y = (int)vehicle.y;
     }
-    return vehicle;
+    return (next < end) ? next : end;
+}
+
+// Advances the simulation by exactly one fixed clock tick, recording it and
+// checking it against a replayed recording when asked to
+void runSimulationTick(SimulationState *state, VehicleSource *source, RunRecorder *recorder, StageTimings *timings) {
+    Simulation *sim = state->simulation;
+    VehicleStore *vehicles = &sim->vehicles;
+    Statistics *stats = &sim->stats;
+    Uint32 now = sim->clock.now;
+    int firstSpawn = vehicles->count;
+
+    if (source->channel != NULL) {
+        // Vehicles come from the generator process
+        drainVehicleChannel(source->channel, sim, now);
+    } else if (source->trace != NULL) {
+        drainVehicleTrace(source->trace, sim, now);
+    } else if (source->replay != NULL) {
+        replaySpawns(source->replay, sim, now);
+    } else {
+        drainArrivals(&source->arrivals, sim, now);
+    }
+    if (recorder != NULL) {
+        recordSpawns(recorder, vehicles, firstSpawn, now);
+    }
+
+    simulationStep(sim, timings);
+
+    if (recorder != NULL) {
+        recordTick(recorder, state, now);
+    }
+    if (source->replay != NULL) {
+        verifyReplayTick(source->replay, sim->lights, stats, now);
+    }
 }
 
-void simulationUpdate(Vehicle* vehicles, TrafficLight* lights) {
-    updateLanePositions(vehicles);
-    
-    // Update each vehicle
-    for (int i = 0; i < MAX_VEHICLES; i++) {
-        if (vehicles[i].active) {
-            updateVehicle(&vehicles[i], lights);
+// Continues a run from a saved snapshot. A snapshot taken with another vehicle
+// source has no arrival process, so the demand is joined at the snapshot's time.
+bool loadSimulation(SimulationState *state, VehicleSource *source, const char *path) {
+    ArrivalProcess *arrivals = state->arrivals;
+    if (!loadSnapshotFile(state, path)) {
+        return false;
+    }
+    Uint32 now = state->simulation->clock.now;
+    if (arrivals != NULL && state->arrivals == NULL) {
+        skipArrivalsBefore(arrivals, now);
+        state->arrivals = arrivals;
+    }
+    if (source->trace != NULL) {
+        while (source->trace->next < source->trace->count && source->trace->records[source->trace->next].timestamp < now) {
+            source->trace->next++;
         }
     }
-    
-    // Update traffic lights
-    updateTrafficLights(lights);
+    printf("Restored snapshot at %.1f s\n", now / 1000.0);
+    return true;
 }
 
 int main(int argc, char *argv[]) {
     SDL_Window *window = NULL;
     SDL_Renderer *renderer = NULL;
     bool running = true;
-    Uint32 lastVehicleSpawn = 0;
-    const Uint32 SPAWN_INTERVAL = 1000;
+    SimulationOptions options;
+    StageTimings timings = {0};
+    VehicleChannel channel;
+    TraceReader trace;
+    RunReplay replay;
+    RunRecorder recorder;
+    RunRecorder *activeRecorder = NULL;
+    VehicleSource source = {0};
 
-    srand(time(NULL));
+    if (!parseArguments(argc, argv, &options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
 
-    initializeSDL(&window, &renderer);
+    // Every random stream derives from this seed, so a run is reproducible from it
+    if (!options.hasSeed) {
+        options.seed = (Uint64)time(NULL);
+    }
 
-    // Initialize vehicles
-    Vehicle vehicles[MAX_VEHICLES] = {0};
-    int vehicleCount = 0;
+    if (options.replicas > 0) {
+        return runEnsembleMode(&options);
+    }
 
-    // Initialize traffic lights
-    TrafficLight lights[4];
-    initializeTrafficLights(lights);
+    if (options.useChannel) {
+        if (!openVehicleChannel(&channel, VEHICLE_CHANNEL_NAME)) {
+            fprintf(stderr, "Could not open the vehicle channel; start the generator with --channel first\n");
+            return 1;
+        }
+        source.channel = &channel;
+    } else if (options.tracePath != NULL) {
+        if (!openTraceReader(&trace, options.tracePath)) {
+            fprintf(stderr, "Could not open vehicle trace %s\n", options.tracePath);
+            return 1;
+        }
+        source.trace = &trace;
+    } else if (options.replayPath != NULL) {
+        if (!openRunReplay(&replay, options.replayPath) || replay.header->tickMs != SIMULATION_TICK_MS) {
+            fprintf(stderr, "Could not replay recording %s\n", options.replayPath);
+            return 1;
+        }
+        source.replay = &replay;
+        // The recording fixes everything the outcome depends on
+        options.seed = replay.header->seed;
+        options.maxVehicles = (int)replay.header->maxVehicles;
+        options.headless = true;
+    } else {
+        initArrivalProcess(&source.arrivals, &options.arrivals, options.seed);
+    }
 
-    // Initialize statistics
-    Statistics stats = {
-        .vehiclesPassed = 0,
-        .totalVehicles = 0,
-        .vehiclesPerMinute = 0,
-        .startTime = SDL_GetTicks()
-    };
+    // All timing is driven by the fixed-step simulation clock, never by wall time
+    Simulation sim;
+    initSimulation(&sim, options.maxVehicles, SIMULATION_TICK_MS);
+    SimulationClock *clock = &sim.clock;
+    Statistics *stats = &sim.stats;
 
-    // Initialize queues
-    for (int i = 0; i < 4; i++) {
-        initQueue(&laneQueues[i]);
+    SimulationState state = {&sim, NULL};
+    bool usesArrivals = source.channel == NULL && source.trace == NULL && source.replay == NULL;
+    if (usesArrivals) {
+        state.arrivals = &source.arrivals;
     }
 
-    while (running) {
-        handleEvents(&running);
+    if (options.loadSnapshotPath != NULL && !loadSimulation(&state, &source, options.loadSnapshotPath)) {
+        fprintf(stderr, "Could not load snapshot %s\n", options.loadSnapshotPath);
+        cleanupSimulation(&sim, &source, NULL);
+        return 1;
+    }
+    if (source.replay != NULL && restoreRunSnapshot(source.replay, &state, (Uint32)(options.replayFromSeconds * 1000.0f))) {
+        printf("Replaying from the snapshot at %.1f s\n", clock->now / 1000.0);
+    }
 
-        // Spawn new vehicles periodically
-        Uint32 currentTime = SDL_GetTicks();
-        if (currentTime - lastVehicleSpawn >= SPAWN_INTERVAL && vehicleCount < MAX_VEHICLES) {
-            Direction spawnDirection = (Direction)(rand() % 4);
-            Vehicle* newVehicle = createVehicle(spawnDirection);
-            
-            // Find empty slot for new vehicle
-            for (int i = 0; i < MAX_VEHICLES; i++) {
-                if (!vehicles[i].active) {
-                    vehicles[i] = *newVehicle;
-                    vehicles[i].active = true;
-                    vehicleCount++;
-                    stats.totalVehicles++;
-                    break;
-                }
+    if (options.recordPath != NULL) {
+        if (!openRunRecorder(&recorder, options.recordPath, options.seed, &state)) {
+            fprintf(stderr, "Could not create recording %s\n", options.recordPath);
+            cleanupSimulation(&sim, &source, NULL);
+            return 1;
+        }
+        activeRecorder = &recorder;
+    }
+
+    if (options.headless) {
+        // Run as fast as possible for the requested simulated duration, or to the end of a replay
+        Uint32 startMs = clock->now;
+        Uint32 startTicks = clock->ticks;
+        Uint32 endMs = startMs + (Uint32)(options.durationSeconds * 1000.0f);
+        if (source.replay != NULL) {
+            endMs = runReplayEnd(source.replay) + clock->tickMs;
+        }
+        // Recordings hold an event for every tick boundary they check, so they are
+        // made and replayed tick by tick
+        bool skipIdle = !options.timeStepped && activeRecorder == NULL && source.replay == NULL;
+        Uint32 computedTicks = 0;
+        Uint64 wallStart = SDL_GetPerformanceCounter();
+        while (clock->now < endMs && !(source.replay != NULL && source.replay->diverged)) {
+            runSimulationTick(&state, &source, activeRecorder, &timings);
+            computedTicks++;
+            if (skipIdle) {
+                skipIdleTicks(&sim, nextVehicleEvent(&source, clock->now, endMs));
             }
-            
-            free(newVehicle);
-            lastVehicleSpawn = currentTime;
         }
+        double wallSeconds = (double)(SDL_GetPerformanceCounter() - wallStart) / SDL_GetPerformanceFrequency();
 
-        // Update vehicles
-        for (int i = 0; i < MAX_VEHICLES; i++) {
-            if (vehicles[i].active) {
-                updateVehicle(&vehicles[i], lights);
+        printf("Simulated %.1f s (seed %llu) in %u ticks: %d vehicles spawned, %d passed, %.2f vehicles/min\n",
+               (clock->now - startMs) / 1000.0, (unsigned long long)options.seed, clock->ticks - startTicks,
+               stats->totalVehicles, stats->vehiclesPassed, stats->vehiclesPerMinute);
+        printf("Computed %u ticks, skipped %u idle ones (%.2f s wall time)\n", computedTicks,
+               clock->ticks - startTicks - computedTicks, wallSeconds);
+        printWaitTimes(&stats->waits);
+        printStageTimings(&timings, computedTicks);
 
-                // Check if vehicle has passed through intersection
-                if (!vehicles[i].active) {
-                    stats.vehiclesPassed++;
-                    vehicleCount--;
-                }
+        int result = 0;
+        if (source.replay != NULL) {
+            if (source.replay->diverged) {
+                printf("Replay diverged from the recording at %u ms\n", source.replay->divergedAt);
+                result = 2;
+            } else {
+                printf("Replay matched the recording (%.2f s wall time)\n", wallSeconds);
             }
         }
+        if (options.saveSnapshotPath != NULL && !saveSnapshotFile(&state, options.saveSnapshotPath)) {
+            fprintf(stderr, "Could not save snapshot %s\n", options.saveSnapshotPath);
+            result = 1;
+        }
+        if (!cleanupSimulation(&sim, &source, activeRecorder)) {
+            fprintf(stderr, "Could not write recording %s\n", options.recordPath);
+            result = 1;
+        }
+        return result;
+    }
 
-        // Update traffic lights
-        updateTrafficLights(lights);
+    initializeSDL(&window, &renderer);
+
+    while (running) {
+        handleEvents(&running);
 
-        // Update statistics
-        float minutes = (SDL_GetTicks() - stats.startTime) / 60000.0f;
-        if (minutes > 0) {
-            stats.vehiclesPerMinute = stats.vehiclesPassed / minutes;
+        // --speed runs several ticks per rendered frame to fast-forward
+        for (int i = 0; i < options.ticksPerFrame; i++) {
+            runSimulationTick(&state, &source, activeRecorder, &timings);
         }
-        simulationUpdate(vehicles, lights);
-        renderSimulation(renderer, vehicles, lights, &stats);
 
-        SDL_Delay(16); // Cap at ~60 FPS
+        renderSimulation(renderer, &sim);
+
+        SDL_Delay(FRAME_DELAY_MS); // Cap at ~60 FPS
     }
 
+    if (options.saveSnapshotPath != NULL && !saveSnapshotFile(&state, options.saveSnapshotPath)) {
+        fprintf(stderr, "Could not save snapshot %s\n", options.saveSnapshotPath);
+    }
+    if (!cleanupSimulation(&sim, &source, activeRecorder)) {
+        fprintf(stderr, "Could not write recording %s\n", options.recordPath);
+    }
     cleanupSDL(window, renderer);
     return 0;
-}
\ No newline at end of file
+}
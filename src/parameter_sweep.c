@@ -0,0 +1,262 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parameter_sweep.h"
+
+// Column names of the swept values in the results file, indexed by SweepDimension
+static const char *const SWEEP_COLUMNS[SWEEP_DIMENSIONS] = {
+    "cycle_ms", "priority_window_ms", "congestion_threshold", "speed_scale", "demand_scale"};
+
+static void singleValueRange(SweepRange *range, double value)
+{
+    range->start = value;
+    range->end = value;
+    range->step = 1;
+}
+
+void defaultSweepConfig(SweepConfig *config)
+{
+    memset(config, 0, sizeof(SweepConfig));
+    singleValueRange(&config->ranges[SWEEP_CYCLE_MS], DEFAULT_SIGNAL_CYCLE_MS);
+    singleValueRange(&config->ranges[SWEEP_PRIORITY_WINDOW_MS], DEFAULT_PRIORITY_WINDOW_MS);
+    singleValueRange(&config->ranges[SWEEP_CONGESTION_THRESHOLD], DEFAULT_CONGESTION_THRESHOLD);
+    singleValueRange(&config->ranges[SWEEP_SPEED_SCALE], 1);
+    singleValueRange(&config->ranges[SWEEP_DEMAND_SCALE], 1);
+    defaultArrivalConfig(&config->arrivals);
+    config->maxVehicles = DEFAULT_MAX_VEHICLES;
+    config->minReplicas = SWEEP_DEFAULT_MIN_REPLICAS;
+    config->maxReplicas = SWEEP_DEFAULT_MAX_REPLICAS;
+    config->precision = SWEEP_DEFAULT_PRECISION;
+}
+
+// Parses "value" or "start:end:step"
+bool parseSweepRange(const char *text, SweepRange *range)
+{
+    char *end;
+    double start = strtod(text, &end);
+    if (end == text)
+    {
+        return false;
+    }
+    if (*end == '\0')
+    {
+        singleValueRange(range, start);
+        return true;
+    }
+    char *next;
+    if (*end != ':')
+    {
+        return false;
+    }
+    double last = strtod(end + 1, &next);
+    if (next == end + 1 || *next != ':')
+    {
+        return false;
+    }
+    end = next;
+    double step = strtod(end + 1, &next);
+    if (next == end + 1 || *next != '\0' || step <= 0 || last < start)
+    {
+        return false;
+    }
+    range->start = start;
+    range->end = last;
+    range->step = step;
+    return true;
+}
+
+static bool wholeNumber(double value)
+{
+    return value == floor(value);
+}
+
+// Signal timings and the congestion threshold are whole numbers, so a range over
+// one must start on a whole number and step by one; otherwise its points would be
+// rounded into duplicates reported under different values. Every value must fit
+// an int, and a signal cycle needs at least 1 ms or the phase changes every tick.
+bool validSweepRange(SweepDimension dimension, const SweepRange *range)
+{
+    if (dimension != SWEEP_CYCLE_MS && dimension != SWEEP_PRIORITY_WINDOW_MS &&
+        dimension != SWEEP_CONGESTION_THRESHOLD)
+    {
+        return true;
+    }
+    double minimum = (dimension == SWEEP_CYCLE_MS) ? 1 : 0;
+    return wholeNumber(range->start) && wholeNumber(range->step) &&
+           range->start >= minimum && range->end <= INT_MAX;
+}
+
+int sweepRangeCount(const SweepRange *range)
+{
+    // The tolerance keeps an end that is a whole number of steps away despite rounding
+    return (int)floor((range->end - range->start) / range->step + 1e-9) + 1;
+}
+
+// Lays out the Cartesian product of the ranges, the last dimension varying fastest
+SweepPoint *createSweepPoints(const SweepConfig *config, int *count)
+{
+    int total = 1;
+    for (int d = 0; d < SWEEP_DIMENSIONS; d++)
+    {
+        total *= sweepRangeCount(&config->ranges[d]);
+    }
+    SweepPoint *points = (SweepPoint *)calloc(total, sizeof(SweepPoint));
+    if (points == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < total; i++)
+    {
+        int rest = i;
+        for (int d = SWEEP_DIMENSIONS - 1; d >= 0; d--)
+        {
+            int size = sweepRangeCount(&config->ranges[d]);
+            points[i].values[d] = config->ranges[d].start + (rest % size) * config->ranges[d].step;
+            rest /= size;
+        }
+    }
+    *count = total;
+    return points;
+}
+
+static void makeReplicaSpec(const SweepConfig *config, const SweepPoint *point, int replica, ReplicaSpec *spec)
+{
+    defaultSimulationParameters(&spec->parameters);
+    spec->parameters.cycleMs = (Uint32)(point->values[SWEEP_CYCLE_MS] + 0.5);
+    spec->parameters.priorityWindowMs = (Uint32)(point->values[SWEEP_PRIORITY_WINDOW_MS] + 0.5);
+    spec->parameters.congestionThreshold = (int)floor(point->values[SWEEP_CONGESTION_THRESHOLD] + 0.5);
+    spec->arrivals = config->arrivals;
+    for (int i = 0; i < 4; i++)
+    {
+        spec->parameters.speeds[i] *= (float)point->values[SWEEP_SPEED_SCALE];
+        spec->arrivals.vehiclesPerMinute[i] *= (float)point->values[SWEEP_DEMAND_SCALE];
+    }
+    // Common random numbers: the seed depends on the replica, never on the point
+    spec->seed = deriveSeed(config->seed, (Uint64)replica);
+    spec->maxVehicles = config->maxVehicles;
+    spec->durationMs = config->durationMs;
+}
+
+static bool withinPrecision(const EnsembleMetric *metric, int count, double precision)
+{
+    return metricConfidence(metric, count) <= precision * fabs(metric->mean);
+}
+
+// Runs the sweep in rounds. Each round gives every unfinished point more
+// replicas, all points' replicas sharing one pass over the work pool.
+void runSweep(const SweepConfig *config, SweepPoint *points, int count)
+{
+    int *targets = (int *)malloc(count * sizeof(int));
+    bool *finished = (bool *)calloc(count, sizeof(bool));
+    int taskCapacity = count * config->minReplicas;
+    ReplicaSpec *specs = (ReplicaSpec *)malloc(taskCapacity * sizeof(ReplicaSpec));
+    Statistics *results = (Statistics *)malloc(taskCapacity * sizeof(Statistics));
+    int *taskPoints = (int *)malloc(taskCapacity * sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        targets[i] = config->minReplicas;
+    }
+
+    for (int round = 1;; round++)
+    {
+        int tasks = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (finished[i])
+            {
+                continue;
+            }
+            for (int replica = points[i].summary.replicas; replica < targets[i]; replica++)
+            {
+                if (tasks == taskCapacity)
+                {
+                    taskCapacity *= 2;
+                    specs = (ReplicaSpec *)realloc(specs, taskCapacity * sizeof(ReplicaSpec));
+                    results = (Statistics *)realloc(results, taskCapacity * sizeof(Statistics));
+                    taskPoints = (int *)realloc(taskPoints, taskCapacity * sizeof(int));
+                }
+                makeReplicaSpec(config, &points[i], replica, &specs[tasks]);
+                taskPoints[tasks++] = i;
+            }
+        }
+        if (tasks == 0)
+        {
+            break;
+        }
+
+        runEnsemble(specs, results, tasks, config->workerCount);
+
+        // Tasks are in replica order within each point, so summaries do not depend on scheduling
+        for (int t = 0; t < tasks; t++)
+        {
+            addEnsembleResult(&points[taskPoints[t]].summary, &results[t]);
+        }
+
+        int done = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const EnsembleSummary *summary = &points[i].summary;
+            if (!finished[i])
+            {
+                points[i].converged = withinPrecision(&summary->vehiclesPerMinute, summary->replicas, config->precision) &&
+                                      withinPrecision(&summary->meanWait, summary->replicas, config->precision);
+                if (points[i].converged || summary->replicas >= config->maxReplicas)
+                {
+                    finished[i] = true;
+                }
+                else
+                {
+                    // Grow geometrically so hard points need few rounds
+                    int more = summary->replicas / 2;
+                    targets[i] = summary->replicas + ((more > 0) ? more : 1);
+                    if (targets[i] > config->maxReplicas)
+                    {
+                        targets[i] = config->maxReplicas;
+                    }
+                }
+            }
+            done += finished[i] ? 1 : 0;
+        }
+        printf("Round %d: ran %d replicas, %d of %d points finished\n", round, tasks, done, count);
+    }
+
+    free(taskPoints);
+    free(results);
+    free(specs);
+    free(finished);
+    free(targets);
+}
+
+// Writes one row per point as comma-separated columns with a header row
+bool writeSweepResults(const char *path, const SweepPoint *points, int count)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    for (int d = 0; d < SWEEP_DIMENSIONS; d++)
+    {
+        fprintf(file, "%s,", SWEEP_COLUMNS[d]);
+    }
+    fprintf(file, "replicas,converged,throughput_per_min,throughput_ci95,delay_s,delay_ci95,vehicles_passed,"
+                  "vehicles_spawned,wait_p50_s,wait_p90_s,wait_p99_s,wait_max_s\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        const EnsembleSummary *summary = &points[i].summary;
+        for (int d = 0; d < SWEEP_DIMENSIONS; d++)
+        {
+            fprintf(file, "%g,", points[i].values[d]);
+        }
+        fprintf(file, "%d,%d,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f,%g,%g,%g,%.3f\n", summary->replicas,
+                points[i].converged ? 1 : 0, summary->vehiclesPerMinute.mean,
+                metricConfidence(&summary->vehiclesPerMinute, summary->replicas), summary->meanWait.mean,
+                metricConfidence(&summary->meanWait, summary->replicas), summary->vehiclesPassed.mean,
+                summary->totalVehicles.mean, waitPercentile(&summary->waits, 0.5), waitPercentile(&summary->waits, 0.9),
+                waitPercentile(&summary->waits, 0.99), summary->waits.maxMs / 1000.0);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,59 @@
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include "ensemble.h"
+
+// Sweeps over signal timings, vehicle speeds and demand. Every point of the
+// Cartesian product of the ranges runs as headless replicas on the work pool.
+// Replica i of every point uses the same seed (common random numbers), so
+// differences between points are not buried in sampling noise. Replicas are
+// added to a point until the 95% confidence intervals of its throughput and
+// delay are tight enough, or it reaches the replica limit.
+#define SWEEP_DEFAULT_MIN_REPLICAS 5
+#define SWEEP_DEFAULT_MAX_REPLICAS 100
+#define SWEEP_DEFAULT_PRECISION 0.05 // Confidence interval half-width relative to the mean
+
+typedef enum {
+    SWEEP_CYCLE_MS,
+    SWEEP_PRIORITY_WINDOW_MS,
+    SWEEP_CONGESTION_THRESHOLD,
+    SWEEP_SPEED_SCALE,  // Multiplies every vehicle type's cruising speed
+    SWEEP_DEMAND_SCALE, // Multiplies every approach's arrival rate
+    SWEEP_DIMENSIONS
+} SweepDimension;
+
+// Values start, start + step, ... up to end inclusive
+typedef struct {
+    double start;
+    double end;
+    double step;
+} SweepRange;
+
+typedef struct {
+    SweepRange ranges[SWEEP_DIMENSIONS];
+    ArrivalConfig arrivals; // Demand at a scale of 1
+    Uint64 seed;
+    int maxVehicles;
+    Uint32 durationMs;
+    int minReplicas;
+    int maxReplicas;
+    double precision;
+    int workerCount;
+} SweepConfig;
+
+typedef struct {
+    double values[SWEEP_DIMENSIONS];
+    EnsembleSummary summary;
+    bool converged;
+} SweepPoint;
+
+void defaultSweepConfig(SweepConfig* config);
+bool parseSweepRange(const char* text, SweepRange* range);
+bool validSweepRange(SweepDimension dimension, const SweepRange* range);
+int sweepRangeCount(const SweepRange* range);
+
+SweepPoint* createSweepPoints(const SweepConfig* config, int* count);
+void runSweep(const SweepConfig* config, SweepPoint* points, int count);
+bool writeSweepResults(const char* path, const SweepPoint* points, int count);
+
+#endif
@@ -0,0 +1,69 @@
+#include "random_stream.h"
+
+static Uint64 splitMix64(Uint64 *state)
+{
+    Uint64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static Uint64 rotateLeft(Uint64 x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// Derives an independent seed, e.g. one per replica of an ensemble
+Uint64 deriveSeed(Uint64 seed, Uint64 index)
+{
+    Uint64 state = seed;
+    Uint64 mixedSeed = splitMix64(&state);
+    state = index ^ 0x6A09E667F3BCC909ULL;
+    return mixedSeed ^ splitMix64(&state);
+}
+
+// The seed and stream id are hashed together and expanded with SplitMix64,
+// which is how the xoshiro authors recommend filling the state
+void seedRandomStream(RandomStream *stream, Uint64 seed, Uint64 streamId)
+{
+    Uint64 state = deriveSeed(seed, streamId);
+    for (int i = 0; i < 4; i++)
+    {
+        stream->state[i] = splitMix64(&state);
+    }
+}
+
+Uint64 nextRandom(RandomStream *stream)
+{
+    Uint64 *s = stream->state;
+    Uint64 result = rotateLeft(s[1] * 5, 7) * 9;
+    Uint64 t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft(s[3], 45);
+    return result;
+}
+
+// Uniform integer in [0, bound); multiply-shift instead of a biased modulo
+Uint32 randomBelow(RandomStream *stream, Uint32 bound)
+{
+    return (Uint32)(((nextRandom(stream) >> 32) * bound) >> 32);
+}
+
+// Uniform float in the open interval (0, 1), safe to take the log of
+float randomFloat(RandomStream *stream)
+{
+    return ((float)(nextRandom(stream) >> 40) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+void fillRandomFloats(RandomStream *stream, float *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        values[i] = randomFloat(stream);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include <SDL.h>
+
+// Small, fast pseudo-random generator (xoshiro256**) with explicit state, so
+// each consumer owns an independent, reproducible stream instead of sharing
+// rand(). A stream is identified by a seed and a stream id; the same pair
+// always produces the same sequence.
+typedef struct {
+    Uint64 state[4];
+} RandomStream;
+
+// Stream ids used by the simulation, so no two consumers draw from the same stream
+typedef enum {
+    RANDOM_STREAM_ARRIVALS = 0, // One per approach, indexed by Direction
+    RANDOM_STREAM_VEHICLE_MIX = 4,
+    RANDOM_STREAM_GENERATOR = 5,
+    RANDOM_STREAM_BENCHMARK = 6
+} RandomStreamId;
+
+void seedRandomStream(RandomStream* stream, Uint64 seed, Uint64 streamId);
+Uint64 deriveSeed(Uint64 seed, Uint64 index);
+
+Uint64 nextRandom(RandomStream* stream);
+Uint32 randomBelow(RandomStream* stream, Uint32 bound);
+float randomFloat(RandomStream* stream);
+void fillRandomFloats(RandomStream* stream, float* values, int count);
+
+#endif
@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+#include "run_log.h"
+
+#define RUN_LOG_WRITE_BUFFER_SIZE (1 << 20)
+#define NO_SIGNALS 0xFF // Never a valid mask, so the first tick is always recorded
+
+static Uint8 greenLightMask(const TrafficLight *lights)
+{
+    Uint8 mask = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (lights[i].state == GREEN)
+        {
+            mask |= (Uint8)(1 << i);
+        }
+    }
+    return mask;
+}
+
+static void writeRunEvent(RunRecorder *recorder, Uint32 timestamp, RunEventKind kind, Uint8 arg0, Uint8 arg1, Uint8 arg2,
+                          Uint32 value)
+{
+    RunEvent event;
+    event.timestamp = timestamp;
+    event.kind = (Uint8)kind;
+    event.args[0] = arg0;
+    event.args[1] = arg1;
+    event.args[2] = arg2;
+    event.value = value;
+    if (fwrite(&event, sizeof(event), 1, recorder->file) != 1)
+    {
+        recorder->failed = true;
+    }
+}
+
+// Embeds a snapshot of the state before the tick at the state's clock time,
+// padded to a whole number of event slots
+static void recordSnapshot(RunRecorder *recorder, const SimulationState *state)
+{
+    size_t size = snapshotSize(state);
+    size_t slots = (size + sizeof(RunEvent) - 1) / sizeof(RunEvent);
+    size_t padded = slots * sizeof(RunEvent);
+    if (padded > recorder->snapshotCapacity)
+    {
+        char *buffer = (char *)realloc(recorder->snapshotBuffer, padded);
+        if (buffer == NULL)
+        {
+            recorder->failed = true;
+            return;
+        }
+        recorder->snapshotBuffer = buffer;
+        recorder->snapshotCapacity = padded;
+    }
+    memset(recorder->snapshotBuffer, 0, padded);
+    writeSnapshot(state, recorder->snapshotBuffer, padded);
+
+    writeRunEvent(recorder, state->simulation->clock.now, RUN_EVENT_SNAPSHOT, 0, 0, 0, (Uint32)slots);
+    if (fwrite(recorder->snapshotBuffer, 1, padded, recorder->file) != padded)
+    {
+        recorder->failed = true;
+    }
+}
+
+// Starts a recording of the run from its current state, which may itself have
+// been restored from a snapshot
+bool openRunRecorder(RunRecorder *recorder, const char *path, Uint64 seed, const SimulationState *state)
+{
+    memset(recorder, 0, sizeof(RunRecorder));
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL)
+    {
+        return false;
+    }
+    setvbuf(recorder->file, NULL, _IOFBF, RUN_LOG_WRITE_BUFFER_SIZE);
+
+    RunLogHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RUN_LOG_MAGIC;
+    header.version = RUN_LOG_VERSION;
+    header.eventSize = sizeof(RunEvent);
+    header.seed = seed;
+    header.tickMs = state->simulation->clock.tickMs;
+    header.maxVehicles = (Uint32)state->simulation->vehicles.maxVehicles;
+    if (fwrite(&header, sizeof(header), 1, recorder->file) != 1)
+    {
+        fclose(recorder->file);
+        recorder->file = NULL;
+        return false;
+    }
+    recorder->greenMask = NO_SIGNALS;
+    recorder->nextCheckpoint = state->simulation->clock.now;
+    recorder->nextSnapshot = state->simulation->clock.now + RUN_LOG_SNAPSHOT_MS;
+    recordSnapshot(recorder, state);
+    return true;
+}
+
+// Records the vehicles spawned this tick; new vehicles are appended to the
+// dense arrays, so they are the ones from firstIndex onwards
+void recordSpawns(RunRecorder *recorder, const VehicleStore *store, int firstIndex, Uint32 now)
+{
+    for (int i = firstIndex; i < store->count; i++)
+    {
+        writeRunEvent(recorder, now, RUN_EVENT_SPAWN, (Uint8)store->direction[i], (Uint8)store->type[i],
+                      (Uint8)store->turnDirection[i], 0);
+    }
+}
+
+// Records what the tick at `now` changed: the signal lights, and a checkpoint
+// and snapshot when they are due
+void recordTick(RunRecorder *recorder, const SimulationState *state, Uint32 now)
+{
+    const Statistics *stats = &state->simulation->stats;
+    Uint8 mask = greenLightMask(state->simulation->lights);
+    if (mask != recorder->greenMask)
+    {
+        writeRunEvent(recorder, now, RUN_EVENT_SIGNALS, mask, 0, 0, 0);
+        recorder->greenMask = mask;
+    }
+    if (now >= recorder->nextCheckpoint)
+    {
+        writeRunEvent(recorder, now, RUN_EVENT_CHECKPOINT, 0, 0, 0, (Uint32)stats->vehiclesPassed);
+        recorder->nextCheckpoint += RUN_LOG_CHECKPOINT_MS;
+    }
+    recorder->lastTick = now;
+    recorder->vehiclesPassed = stats->vehiclesPassed;
+
+    // The clock has already moved on, so this captures the start of the next tick
+    if (state->simulation->clock.now >= recorder->nextSnapshot)
+    {
+        recordSnapshot(recorder, state);
+        recorder->nextSnapshot += RUN_LOG_SNAPSHOT_MS;
+    }
+}
+
+// Ends the log with a checkpoint of the last tick, so a replay checks the final statistics.
+// Returns false if any part of the log could not be written, e.g. on a full disk.
+bool closeRunRecorder(RunRecorder *recorder)
+{
+    if (recorder->file == NULL)
+    {
+        return !recorder->failed;
+    }
+    writeRunEvent(recorder, recorder->lastTick, RUN_EVENT_CHECKPOINT, 0, 0, 0, (Uint32)recorder->vehiclesPassed);
+    // Closing flushes the write buffer, which is where a full disk usually shows
+    if (fclose(recorder->file) != 0)
+    {
+        recorder->failed = true;
+    }
+    recorder->file = NULL;
+    free(recorder->snapshotBuffer);
+    recorder->snapshotBuffer = NULL;
+    recorder->snapshotCapacity = 0;
+    return !recorder->failed;
+}
+
+bool openRunReplay(RunReplay *replay, const char *path)
+{
+    memset(replay, 0, sizeof(RunReplay));
+    if (!mapFile(&replay->file, path, sizeof(RunLogHeader)))
+    {
+        return false;
+    }
+
+    replay->header = (const RunLogHeader *)replay->file.view;
+    if (replay->header->magic != RUN_LOG_MAGIC || replay->header->version != RUN_LOG_VERSION ||
+        replay->header->eventSize != sizeof(RunEvent))
+    {
+        closeRunReplay(replay);
+        return false;
+    }
+    replay->events = (const RunEvent *)((const char *)replay->file.view + sizeof(RunLogHeader));
+    replay->count = (replay->file.size - sizeof(RunLogHeader)) / sizeof(RunEvent);
+    // A complete log holds whole events and ends with the checkpoint closeRunRecorder
+    // writes; anything else was cut short, and its last slot is not the end of the run
+    if ((replay->file.size - sizeof(RunLogHeader)) % sizeof(RunEvent) != 0 || replay->count == 0 ||
+        replay->events[replay->count - 1].kind != RUN_EVENT_CHECKPOINT)
+    {
+        closeRunReplay(replay);
+        return false;
+    }
+    replay->greenMask = NO_SIGNALS;
+    return true;
+}
+
+void closeRunReplay(RunReplay *replay)
+{
+    unmapFile(&replay->file);
+    memset(replay, 0, sizeof(RunReplay));
+}
+
+// Time of the last recorded tick
+Uint32 runReplayEnd(const RunReplay *replay)
+{
+    return (replay->count > 0) ? replay->events[replay->count - 1].timestamp : 0;
+}
+
+// Number of event slots an event occupies, including an embedded snapshot
+static Uint64 runEventSpan(const RunEvent *event)
+{
+    return (event->kind == RUN_EVENT_SNAPSHOT) ? 1 + (Uint64)event->value : 1;
+}
+
+// Restores the latest embedded snapshot taken at or before `time`, or the first
+// one if the recording starts later, and continues the replay from there.
+// Returns false, leaving the replay at the start of the log, if there is none.
+bool restoreRunSnapshot(RunReplay *replay, SimulationState *state, Uint32 time)
+{
+    Uint64 found = replay->count;
+    for (Uint64 i = 0; i < replay->count; i += runEventSpan(&replay->events[i]))
+    {
+        const RunEvent *event = &replay->events[i];
+        if (found != replay->count && event->timestamp > time)
+        {
+            break;
+        }
+        if (event->kind == RUN_EVENT_SNAPSHOT && i + runEventSpan(event) <= replay->count)
+        {
+            found = i;
+        }
+    }
+    if (found == replay->count)
+    {
+        return false;
+    }
+
+    const RunEvent *event = &replay->events[found];
+    if (!restoreSnapshot(state, event + 1, (size_t)event->value * sizeof(RunEvent)))
+    {
+        return false;
+    }
+    replay->next = found + runEventSpan(event);
+    replay->greenMask = greenLightMask(state->simulation->lights);
+    return true;
+}
+
+// Spawns the recorded vehicles of the tick at `now`. A spawn that fails is left
+// in place and reported as a divergence by verifyReplayTick.
+void replaySpawns(RunReplay *replay, Simulation *sim, Uint32 now)
+{
+    while (replay->next < replay->count && replay->events[replay->next].timestamp <= now)
+    {
+        const RunEvent *event = &replay->events[replay->next];
+        if (event->kind == RUN_EVENT_SNAPSHOT)
+        {
+            replay->next += runEventSpan(event);
+            continue;
+        }
+        if (event->kind != RUN_EVENT_SPAWN)
+        {
+            return;
+        }
+        SpawnRecord record;
+        record.timestamp = event->timestamp;
+        record.direction = event->args[0];
+        record.type = event->args[1];
+        record.turnDirection = event->args[2];
+        record.lane = (event->args[2] == TURN_RIGHT) ? 1 : 0;
+        if (spawnVehicleFromRecord(sim, &record) < 0)
+        {
+            return;
+        }
+        sim->stats.totalVehicles++;
+        replay->next++;
+    }
+}
+
+static bool divergeReplay(RunReplay *replay, Uint32 now)
+{
+    replay->diverged = true;
+    replay->divergedAt = now;
+    return false;
+}
+
+// Checks the tick at `now` against the recording: every spawn must have happened,
+// the lights must change exactly when and how they did, and checkpoints must match.
+// Returns false, and marks the replay as diverged, on the first mismatch.
+bool verifyReplayTick(RunReplay *replay, const TrafficLight *lights, const Statistics *stats, Uint32 now)
+{
+    Uint8 mask = greenLightMask(lights);
+    bool signalsRecorded = false;
+
+    while (replay->next < replay->count && replay->events[replay->next].timestamp <= now)
+    {
+        const RunEvent *event = &replay->events[replay->next];
+        if (event->kind == RUN_EVENT_SNAPSHOT)
+        {
+            replay->next += runEventSpan(event);
+            continue;
+        }
+        if (event->timestamp != now || event->kind == RUN_EVENT_SPAWN)
+        {
+            return divergeReplay(replay, now);
+        }
+        if (event->kind == RUN_EVENT_SIGNALS)
+        {
+            if (event->args[0] != mask)
+            {
+                return divergeReplay(replay, now);
+            }
+            replay->greenMask = mask;
+            signalsRecorded = true;
+        }
+        else if (event->kind == RUN_EVENT_CHECKPOINT && event->value != (Uint32)stats->vehiclesPassed)
+        {
+            return divergeReplay(replay, now);
+        }
+        replay->next++;
+    }
+
+    if (!signalsRecorded && mask != replay->greenMask)
+    {
+        return divergeReplay(replay, now);
+    }
+    return true;
+}
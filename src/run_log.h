@@ -0,0 +1,81 @@
+#ifndef RUN_LOG_H
+#define RUN_LOG_H
+
+#include <stdio.h>
+#include "traffic_simulation.h"
+#include "vehicle_trace.h"
+#include "snapshot.h"
+
+// Recording of a run: every vehicle spawn, every change of the signal lights
+// and periodic checkpoints of the statistics, in tick order. The simulation
+// is deterministic given its spawns, so replaying a log re-executes the run
+// exactly; the signal changes and checkpoints are checked along the way.
+// Full state snapshots are embedded at the start and at regular intervals,
+// so a replay can begin at any of them.
+#define RUN_LOG_MAGIC 0x4E555254 // "TRUN"
+#define RUN_LOG_VERSION 4
+#define RUN_LOG_CHECKPOINT_MS 60000 // Simulated time between checkpoints
+#define RUN_LOG_SNAPSHOT_MS 600000  // Simulated time between embedded snapshots
+
+typedef enum {
+    RUN_EVENT_SPAWN,      // args: direction, type, turn direction
+    RUN_EVENT_SIGNALS,    // args[0]: bit i set when light i is green
+    RUN_EVENT_CHECKPOINT, // value: vehicles passed so far
+    RUN_EVENT_SNAPSHOT    // value: event slots taken by the snapshot that follows
+} RunEventKind;
+
+typedef struct {
+    Uint32 timestamp; // Simulated ms of the tick the event belongs to; for snapshots, the tick they precede
+    Uint8 kind;
+    Uint8 args[3];
+    Uint32 value;
+} RunEvent;
+
+typedef struct {
+    Uint32 magic;
+    Uint16 version;
+    Uint16 eventSize;
+    Uint64 seed;
+    Uint32 tickMs;
+    Uint32 maxVehicles;
+} RunLogHeader;
+
+SDL_COMPILE_TIME_ASSERT(runEventSize, sizeof(RunEvent) == 12);
+SDL_COMPILE_TIME_ASSERT(runLogHeaderSize, sizeof(RunLogHeader) == 24);
+
+typedef struct {
+    FILE* file;
+    Uint8 greenMask;
+    Uint32 nextCheckpoint;
+    Uint32 nextSnapshot;
+    Uint32 lastTick;
+    int vehiclesPassed;
+    char* snapshotBuffer;
+    size_t snapshotCapacity;
+    bool failed; // A write failed, so the log is incomplete; reported by closeRunRecorder
+} RunRecorder;
+
+typedef struct {
+    MappedFile file;
+    const RunLogHeader* header;
+    const RunEvent* events;
+    Uint64 count;
+    Uint64 next;
+    Uint8 greenMask;
+    bool diverged;
+    Uint32 divergedAt;
+} RunReplay;
+
+bool openRunRecorder(RunRecorder* recorder, const char* path, Uint64 seed, const SimulationState* state);
+void recordSpawns(RunRecorder* recorder, const VehicleStore* store, int firstIndex, Uint32 now);
+void recordTick(RunRecorder* recorder, const SimulationState* state, Uint32 now);
+bool closeRunRecorder(RunRecorder* recorder);
+
+bool openRunReplay(RunReplay* replay, const char* path);
+void closeRunReplay(RunReplay* replay);
+Uint32 runReplayEnd(const RunReplay* replay);
+bool restoreRunSnapshot(RunReplay* replay, SimulationState* state, Uint32 time);
+void replaySpawns(RunReplay* replay, Simulation* sim, Uint32 now);
+bool verifyReplayTick(RunReplay* replay, const TrafficLight* lights, const Statistics* stats, Uint32 now);
+
+#endif
@@ -0,0 +1,477 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "vehicle_trace.h"
+
+#define SNAPSHOT_ALIGNMENT 8
+
+// Fixed-size part of a snapshot; the variable-length arrays follow it
+typedef struct {
+    SimulationParameters parameters;
+    SimulationClock clock;
+    Statistics stats;
+    TrafficLight lights[4];
+    SignalController controller;
+    int lanePriorities[4];
+    int vehicleCount;
+    int vehicleCapacity;
+    int maxVehicles;
+    int freeCount;
+    int queueCapacity[4];
+    int queueSize[4];
+    int queueHighWaterMark[4];
+} SnapshotCore;
+
+// Which elements of a VehicleStore array hold live data. Only those are stored,
+// so slots past the end of the dense arrays and the free list never reach a snapshot.
+typedef enum {
+    STORE_DENSE,    // [0, count): one per active vehicle
+    STORE_BY_ID,    // [0, capacity): indexed by vehicle id
+    STORE_FREE_LIST // [0, freeCount)
+} StoreExtent;
+
+// Every VehicleStore array
+typedef struct {
+    size_t offset;
+    size_t elementSize;
+    StoreExtent extent;
+} StoreArray;
+
+static const StoreArray STORE_ARRAYS[] = {
+    {offsetof(VehicleStore, x), sizeof(float), STORE_DENSE},
+    {offsetof(VehicleStore, y), sizeof(float), STORE_DENSE},
+    {offsetof(VehicleStore, speed), sizeof(float), STORE_DENSE},
+    {offsetof(VehicleStore, state), sizeof(VehicleState), STORE_DENSE},
+    {offsetof(VehicleStore, direction), sizeof(Direction), STORE_DENSE},
+    {offsetof(VehicleStore, type), sizeof(VehicleType), STORE_DENSE},
+    {offsetof(VehicleStore, ids), sizeof(int), STORE_DENSE},
+    {offsetof(VehicleStore, turnDirection), sizeof(TurnDirection), STORE_DENSE},
+    {offsetof(VehicleStore, turnAngle), sizeof(float), STORE_DENSE},
+    {offsetof(VehicleStore, isInRightLane), sizeof(bool), STORE_DENSE},
+    {offsetof(VehicleStore, canSkipLight), sizeof(bool), STORE_DENSE},
+    {offsetof(VehicleStore, waitMs), sizeof(Uint32), STORE_DENSE},
+    {offsetof(VehicleStore, denseIndex), sizeof(int), STORE_BY_ID},
+    {offsetof(VehicleStore, generations), sizeof(Uint32), STORE_BY_ID},
+    {offsetof(VehicleStore, leaders), sizeof(VehicleHandle), STORE_BY_ID},
+    {offsetof(VehicleStore, freeIds), sizeof(int), STORE_FREE_LIST},
+};
+#define STORE_ARRAY_COUNT (int)(sizeof(STORE_ARRAYS) / sizeof(STORE_ARRAYS[0]))
+
+static void **storeArray(VehicleStore *store, int index)
+{
+    return (void **)((char *)store + STORE_ARRAYS[index].offset);
+}
+
+// Bytes of live data in one of the store's arrays
+static size_t storeArrayBytes(const VehicleStore *store, int index)
+{
+    int length = store->capacity;
+    switch (STORE_ARRAYS[index].extent)
+    {
+    case STORE_DENSE:
+        length = store->count;
+        break;
+    case STORE_FREE_LIST:
+        length = store->freeCount;
+        break;
+    default:
+        break;
+    }
+    return (size_t)length * STORE_ARRAYS[index].elementSize;
+}
+
+// Structures with padding are copied field by field into zeroed ones, so no
+// stray bytes end up in the snapshot and equal states give equal snapshots
+static void copySignalController(SignalController *to, const SignalController *from)
+{
+    memset(to, 0, sizeof(*to));
+    to->lastStateChangeTicks = from->lastStateChangeTicks;
+    to->currentPhase = from->currentPhase;
+    to->priorityMode = from->priorityMode;
+    to->priorityLane = from->priorityLane;
+    to->priorityStartTime = from->priorityStartTime;
+}
+
+static void copyVehicle(Vehicle *to, const Vehicle *from)
+{
+    memset(to, 0, sizeof(*to));
+    to->rect = from->rect;
+    to->type = from->type;
+    to->direction = from->direction;
+    to->turnDirection = from->turnDirection;
+    to->state = from->state;
+    to->speed = from->speed;
+    to->x = from->x;
+    to->y = from->y;
+    to->active = from->active;
+    to->turnAngle = from->turnAngle;
+    to->isInRightLane = from->isInRightLane;
+    to->turnProgress = from->turnProgress;
+    to->canSkipLight = from->canSkipLight;
+}
+
+static void copyArrivalProcess(ArrivalProcess *to, const ArrivalProcess *from)
+{
+    memset(to, 0, sizeof(*to));
+    to->config = from->config;
+    memcpy(to->nextArrival, from->nextArrival, sizeof(to->nextArrival));
+    memcpy(to->gaps, from->gaps, sizeof(to->gaps));
+    memcpy(to->gapIndex, from->gapIndex, sizeof(to->gapIndex));
+    memcpy(to->typeCdf, from->typeCdf, sizeof(to->typeCdf));
+    memcpy(to->turnCdf, from->turnCdf, sizeof(to->turnCdf));
+    memcpy(to->gapStreams, from->gapStreams, sizeof(to->gapStreams));
+    to->mixStream = from->mixStream;
+    memcpy(to->upcoming, from->upcoming, sizeof(to->upcoming));
+    to->upcomingNext = from->upcomingNext;
+    to->upcomingCount = from->upcomingCount;
+}
+
+// Sequential cursor over a snapshot buffer. With a NULL buffer it only measures.
+typedef struct {
+    char *buffer;
+    size_t offset;
+    size_t capacity;
+} SnapshotCursor;
+
+static size_t alignSnapshotOffset(size_t offset)
+{
+    return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+static void putSection(SnapshotCursor *cursor, const void *data, size_t size)
+{
+    size_t start = alignSnapshotOffset(cursor->offset);
+    if (cursor->buffer != NULL && start + size <= cursor->capacity)
+    {
+        memset(cursor->buffer + cursor->offset, 0, start - cursor->offset);
+        memcpy(cursor->buffer + start, data, size);
+    }
+    cursor->offset = start + size;
+}
+
+static bool takeSection(SnapshotCursor *cursor, void *data, size_t size)
+{
+    size_t start = alignSnapshotOffset(cursor->offset);
+    if (start + size > cursor->capacity)
+    {
+        return false;
+    }
+    memcpy(data, cursor->buffer + start, size);
+    cursor->offset = start + size;
+    return true;
+}
+
+static void serializeSnapshot(const SimulationState *state, SnapshotCursor *cursor)
+{
+    Simulation *sim = state->simulation;
+    VehicleStore *store = &sim->vehicles;
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.flags = (state->arrivals != NULL) ? SNAPSHOT_HAS_ARRIVALS : 0;
+    putSection(cursor, &header, sizeof(header));
+
+    SnapshotCore core;
+    memset(&core, 0, sizeof(core));
+    core.parameters = sim->parameters;
+    core.clock = sim->clock;
+    core.stats = sim->stats;
+    memcpy(core.lights, sim->lights, sizeof(core.lights));
+    copySignalController(&core.controller, &sim->controller);
+    memcpy(core.lanePriorities, sim->lanePriorities, sizeof(core.lanePriorities));
+    core.vehicleCount = store->count;
+    core.vehicleCapacity = store->capacity;
+    core.maxVehicles = store->maxVehicles;
+    core.freeCount = store->freeCount;
+    for (int i = 0; i < 4; i++)
+    {
+        core.queueCapacity[i] = sim->laneQueues[i].capacity;
+        core.queueSize[i] = sim->laneQueues[i].size;
+        core.queueHighWaterMark[i] = sim->laneQueues[i].highWaterMark;
+    }
+    putSection(cursor, &core, sizeof(core));
+
+    for (int i = 0; i < STORE_ARRAY_COUNT; i++)
+    {
+        putSection(cursor, *storeArray(store, i), storeArrayBytes(store, i));
+    }
+
+    // Queues are stored front to back, so a restored ring starts at index 0
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < sim->laneQueues[i].size; j++)
+        {
+            Vehicle vehicle;
+            copyVehicle(&vehicle, queueAt(&sim->laneQueues[i], j));
+            putSection(cursor, &vehicle, sizeof(Vehicle));
+        }
+    }
+
+    if (state->arrivals != NULL)
+    {
+        ArrivalProcess arrivals;
+        copyArrivalProcess(&arrivals, state->arrivals);
+        putSection(cursor, &arrivals, sizeof(ArrivalProcess));
+    }
+    cursor->offset = alignSnapshotOffset(cursor->offset);
+
+    // The total size is only known now; patch it into the header
+    if (cursor->buffer != NULL && cursor->offset <= cursor->capacity)
+    {
+        Uint64 size = cursor->offset;
+        memcpy(cursor->buffer + offsetof(SnapshotHeader, size), &size, sizeof(size));
+    }
+}
+
+// Checks that a restored store is internally consistent: every id is either
+// active, with its dense slot pointing back at it, or on the free list exactly
+// once, and every field used as an index is in range
+static bool validVehicleStore(const VehicleStore *store)
+{
+    if (store->count + store->freeCount != store->capacity)
+    {
+        return false;
+    }
+    for (int i = 0; i < store->count; i++)
+    {
+        int id = store->ids[i];
+        if (id < 0 || id >= store->capacity || store->denseIndex[id] != i ||
+            (unsigned)store->state[i] > STATE_TURNING || (unsigned)store->direction[i] > DIRECTION_WEST ||
+            (unsigned)store->type[i] > FIRE_TRUCK || (unsigned)store->turnDirection[i] > TURN_RIGHT ||
+            !(store->turnAngle[i] >= 0 && store->turnAngle[i] <= TURN_ARC_STEPS))
+        {
+            return false;
+        }
+    }
+    bool *seen = (bool *)calloc(store->capacity > 0 ? store->capacity : 1, sizeof(bool));
+    if (seen == NULL)
+    {
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; i < store->freeCount && ok; i++)
+    {
+        int id = store->freeIds[i];
+        ok = id >= 0 && id < store->capacity && store->denseIndex[id] == -1 && !seen[id];
+        if (ok)
+        {
+            seen[id] = true;
+        }
+    }
+    free(seen);
+    for (int id = 0; id < store->capacity && ok; id++)
+    {
+        ok = store->leaders[id].id >= -1 && store->leaders[id].id < store->capacity;
+    }
+    return ok;
+}
+
+// Checks the arrival process fields used as array indices, and the arrivals it
+// has generated but not yet handed out
+static bool validArrivalProcess(const ArrivalProcess *arrivals)
+{
+    if (arrivals->config.profileSegments < 0 || arrivals->config.profileSegments > ARRIVAL_PROFILE_MAX_SEGMENTS ||
+        arrivals->upcomingCount < 0 || arrivals->upcomingCount > ARRIVAL_SAMPLE_BATCH ||
+        arrivals->upcomingNext < 0 || arrivals->upcomingNext > arrivals->upcomingCount)
+    {
+        return false;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        if (arrivals->gapIndex[i] < 0 || arrivals->gapIndex[i] > ARRIVAL_SAMPLE_BATCH)
+        {
+            return false;
+        }
+    }
+    for (int i = arrivals->upcomingNext; i < arrivals->upcomingCount; i++)
+    {
+        const SpawnRecord *record = &arrivals->upcoming[i];
+        if (record->direction > DIRECTION_WEST || record->type > FIRE_TRUCK || record->turnDirection > TURN_RIGHT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t snapshotSize(const SimulationState *state)
+{
+    SnapshotCursor cursor = {NULL, 0, 0};
+    serializeSnapshot(state, &cursor);
+    return cursor.offset;
+}
+
+// Writes a snapshot into buffer. Returns its size, or 0 if it does not fit.
+size_t writeSnapshot(const SimulationState *state, void *buffer, size_t capacity)
+{
+    SnapshotCursor cursor = {(char *)buffer, 0, capacity};
+    serializeSnapshot(state, &cursor);
+    return (cursor.offset <= capacity) ? cursor.offset : 0;
+}
+
+// Replaces the current state with a snapshot. The vehicle store and lane queues
+// are reallocated to the snapshot's sizes and the lane index is rebuilt from it.
+// Returns false, leaving the state unchanged, if the buffer is not a valid snapshot.
+bool restoreSnapshot(SimulationState *state, const void *buffer, size_t size)
+{
+    SnapshotCursor cursor = {(char *)buffer, 0, size};
+    SnapshotHeader header;
+    SnapshotCore core;
+    if (!takeSection(&cursor, &header, sizeof(header)) || header.magic != SNAPSHOT_MAGIC ||
+        header.version != SNAPSHOT_VERSION || header.size > size || !takeSection(&cursor, &core, sizeof(core)))
+    {
+        return false;
+    }
+    cursor.capacity = (size_t)header.size;
+    if (core.vehicleCount < 0 || core.vehicleCount > core.vehicleCapacity || core.vehicleCapacity > core.maxVehicles ||
+        core.freeCount < 0 || core.freeCount > core.vehicleCapacity || core.controller.priorityLane < -1 ||
+        core.controller.priorityLane >= 4)
+    {
+        return false;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        if ((unsigned)core.lights[i].state > GREEN)
+        {
+            return false;
+        }
+    }
+    // A lane queue never needs more room than twice the vehicle limit, which
+    // covers rounding up to a power of two, or its presized capacity
+    long long queueLimit = 2LL * core.maxVehicles;
+    if (queueLimit < LANE_QUEUE_CAPACITY)
+    {
+        queueLimit = LANE_QUEUE_CAPACITY;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        if (core.queueSize[i] < 0 || core.queueSize[i] > core.queueCapacity[i] || core.queueCapacity[i] > queueLimit)
+        {
+            return false;
+        }
+    }
+
+    // Read into a fresh store so a truncated snapshot leaves the old one intact
+    VehicleStore store;
+    memset(&store, 0, sizeof(store));
+    store.count = core.vehicleCount;
+    store.capacity = core.vehicleCapacity;
+    store.maxVehicles = core.maxVehicles;
+    store.freeCount = core.freeCount;
+    bool ok = true;
+    for (int i = 0; i < STORE_ARRAY_COUNT && ok; i++)
+    {
+        // Slots past the stored elements start out zeroed
+        *storeArray(&store, i) = calloc(core.vehicleCapacity > 0 ? core.vehicleCapacity : 1, STORE_ARRAYS[i].elementSize);
+        ok = *storeArray(&store, i) != NULL && takeSection(&cursor, *storeArray(&store, i), storeArrayBytes(&store, i));
+    }
+    ok = ok && validVehicleStore(&store);
+
+    Queue queues[4];
+    for (int i = 0; i < 4; i++)
+    {
+        initQueue(&queues[i]);
+        if (!ok)
+        {
+            continue;
+        }
+        ok = reserveQueue(&queues[i], core.queueCapacity[i]);
+        for (int j = 0; j < core.queueSize[i] && ok; j++)
+        {
+            ok = takeSection(&cursor, &queues[i].items[j], sizeof(Vehicle));
+        }
+        queues[i].size = core.queueSize[i];
+        queues[i].highWaterMark = core.queueHighWaterMark[i];
+    }
+
+    bool hasArrivals = (header.flags & SNAPSHOT_HAS_ARRIVALS) != 0;
+    ArrivalProcess *arrivals = NULL;
+    if (ok && hasArrivals)
+    {
+        arrivals = (ArrivalProcess *)malloc(sizeof(ArrivalProcess));
+        ok = arrivals != NULL && takeSection(&cursor, arrivals, sizeof(ArrivalProcess)) && validArrivalProcess(arrivals);
+    }
+
+    if (!ok)
+    {
+        freeVehicleStore(&store);
+        for (int i = 0; i < 4; i++)
+        {
+            freeQueue(&queues[i]);
+        }
+        free(arrivals);
+        return false;
+    }
+
+    Simulation *sim = state->simulation;
+    freeVehicleStore(&sim->vehicles);
+    sim->vehicles = store;
+    for (int i = 0; i < 4; i++)
+    {
+        freeQueue(&sim->laneQueues[i]);
+        sim->laneQueues[i] = queues[i];
+    }
+    if (state->arrivals != NULL)
+    {
+        if (arrivals != NULL)
+        {
+            *state->arrivals = *arrivals;
+        }
+        else
+        {
+            state->arrivals = NULL; // Tell the caller the snapshot had no arrival process
+        }
+    }
+    free(arrivals);
+
+    sim->parameters = core.parameters;
+    sim->idle = false; // Decided afresh by the next tick
+    wakeAllVehicles(sim);
+    sim->clock = core.clock;
+    sim->stats = core.stats;
+    memcpy(sim->lights, core.lights, sizeof(core.lights));
+    sim->controller = core.controller;
+    memcpy(sim->lanePriorities, core.lanePriorities, sizeof(core.lanePriorities));
+
+    // The lane index is derived from the vehicles, so it is rebuilt rather than stored
+    updateLanePositions(sim);
+    return true;
+}
+
+bool saveSnapshotFile(const SimulationState *state, const char *path)
+{
+    size_t size = snapshotSize(state);
+    void *buffer = malloc(size);
+    if (buffer == NULL)
+    {
+        return false;
+    }
+    writeSnapshot(state, buffer, size);
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(buffer, 1, size, file) == size;
+    if (file != NULL && fclose(file) != 0)
+    {
+        ok = false;
+    }
+    free(buffer);
+    return ok;
+}
+
+// Maps a snapshot file and restores straight out of the mapping
+bool loadSnapshotFile(SimulationState *state, const char *path)
+{
+    MappedFile file;
+    memset(&file, 0, sizeof(file));
+    if (!mapFile(&file, path, sizeof(SnapshotHeader)))
+    {
+        return false;
+    }
+    bool ok = restoreSnapshot(state, file.view, file.size);
+    unmapFile(&file);
+    return ok;
+}
@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "traffic_simulation.h"
+#include "arrival_process.h"
+
+// A snapshot holds the complete simulation state in one contiguous, versioned
+// buffer. Every section starts 8-byte aligned, so a snapshot file can be
+// mapped and restored from in place. Structures are stored in their in-memory
+// layout, so snapshots are only portable between builds for the same platform.
+#define SNAPSHOT_MAGIC 0x504E5354 // "TSNP"
+#define SNAPSHOT_VERSION 6
+#define SNAPSHOT_HAS_ARRIVALS 0x1
+
+typedef struct {
+    Uint32 magic;
+    Uint16 version;
+    Uint16 flags;
+    Uint64 size; // Total bytes, including this header
+} SnapshotHeader;
+
+// The state a snapshot covers: the intersection and, optionally, the arrival
+// process feeding it
+typedef struct {
+    Simulation* simulation;
+    ArrivalProcess* arrivals; // Optional; restoring sets it to NULL if the snapshot has none
+} SimulationState;
+
+size_t snapshotSize(const SimulationState* state);
+size_t writeSnapshot(const SimulationState* state, void* buffer, size_t capacity);
+bool restoreSnapshot(SimulationState* state, const void* buffer, size_t size);
+
+bool saveSnapshotFile(const SimulationState* state, const char* path);
+bool loadSnapshotFile(SimulationState* state, const char* path);
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parameter_sweep.h"
+#include "work_pool.h"
+
+#define DEFAULT_SWEEP_DURATION_S 3600
+#define DEFAULT_RESULTS_PATH "bin/sweep.csv"
+
+// Command-line option for each swept dimension, indexed by SweepDimension
+static const char *const RANGE_OPTIONS[SWEEP_DIMENSIONS] = {
+    "--cycle", "--priority-window", "--congestion", "--speed-scale", "--demand-scale"};
+
+static void printUsage(const char *program)
+{
+    printf("Usage: %s [--cycle <ms>] [--priority-window <ms>] [--congestion <vehicles>] [--speed-scale <x>] [--demand-scale <x>]\n"
+           "       [--duration <simulated seconds>] [--seed <n>] [--max-vehicles <n>] [--threads <n>]\n"
+           "       [--min-replicas <n>] [--max-replicas <n>] [--precision <fraction>] [--output <file>]\n"
+           "       " ARRIVAL_OPTIONS_USAGE "\n"
+           "Every swept value is either a single number or start:end:step. Cycle, priority window\n"
+           "and congestion values are whole numbers, and the cycle is at least 1 ms.\n",
+           program);
+}
+
+static int findRangeOption(const char *option)
+{
+    for (int d = 0; d < SWEEP_DIMENSIONS; d++)
+    {
+        if (strcmp(option, RANGE_OPTIONS[d]) == 0)
+        {
+            return d;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    SweepConfig config;
+    defaultSweepConfig(&config);
+    config.seed = (Uint64)time(NULL);
+    config.durationMs = DEFAULT_SWEEP_DURATION_S * 1000;
+    config.workerCount = defaultWorkerCount();
+    const char *outputPath = DEFAULT_RESULTS_PATH;
+
+    for (int i = 1; i < argc; i++)
+    {
+        int dimension = findRangeOption(argv[i]);
+        bool valid = i + 1 < argc;
+        if (dimension >= 0 && valid)
+        {
+            valid = parseSweepRange(argv[++i], &config.ranges[dimension]) &&
+                    validSweepRange((SweepDimension)dimension, &config.ranges[dimension]);
+        }
+        else if (strcmp(argv[i], "--duration") == 0 && valid)
+        {
+            double seconds = atof(argv[++i]);
+            valid = seconds > 0;
+            config.durationMs = (Uint32)(seconds * 1000.0);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && valid)
+        {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--max-vehicles") == 0 && valid)
+        {
+            config.maxVehicles = atoi(argv[++i]);
+            valid = config.maxVehicles > 0;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && valid)
+        {
+            config.workerCount = atoi(argv[++i]);
+            valid = config.workerCount > 0;
+        }
+        else if (strcmp(argv[i], "--min-replicas") == 0 && valid)
+        {
+            config.minReplicas = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-replicas") == 0 && valid)
+        {
+            config.maxReplicas = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--precision") == 0 && valid)
+        {
+            config.precision = atof(argv[++i]);
+            valid = config.precision > 0;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && valid)
+        {
+            outputPath = argv[++i];
+        }
+        else if (valid && parseArrivalOption(&config.arrivals, argv[i], argv[i + 1]) > 0)
+        {
+            i++;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // A confidence interval needs at least two replicas
+    if (config.minReplicas < 2 || config.maxReplicas < config.minReplicas)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int count;
+    SweepPoint *points = createSweepPoints(&config, &count);
+    if (points == NULL)
+    {
+        fprintf(stderr, "Could not allocate the sweep points\n");
+        return 1;
+    }
+    printf("Sweeping %d points of %.1f s (seed %llu) on %d threads\n", count, config.durationMs / 1000.0,
+           (unsigned long long)config.seed, config.workerCount);
+
+    Uint64 wallStart = SDL_GetPerformanceCounter();
+    runSweep(&config, points, count);
+    double wallSeconds = (double)(SDL_GetPerformanceCounter() - wallStart) / SDL_GetPerformanceFrequency();
+
+    int converged = 0;
+    for (int i = 0; i < count; i++)
+    {
+        converged += points[i].converged ? 1 : 0;
+    }
+    int result = 0;
+    if (writeSweepResults(outputPath, points, count))
+    {
+        printf("Wrote %d points (%d within precision) to %s in %.2f s wall time\n", count, converged, outputPath,
+               wallSeconds);
+    }
+    else
+    {
+        fprintf(stderr, "Could not write results to %s\n", outputPath);
+        result = 1;
+    }
+    free(points);
+    return result;
+}
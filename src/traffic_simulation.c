@@ -1,13 +1,55 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "traffic_simulation.h"
 
-// Global queues for lanes
-Queue laneQueues[4];
-int lanePriorities[4] = {0};
-LanePosition laneVehicles[4][MAX_VEHICLES];
-int vehiclesInLane[4] = {0};
+// Cruising speeds in pixels per tick, indexed by VehicleType
+static const float DEFAULT_SPEEDS[] = {2.0f, 4.0f, 4.0f, 3.5f};
+
+// Geometry of one approach. Positions along it are measured as heading . (x, y),
+// so they grow in the direction of travel and one comparison serves every approach.
+typedef struct {
+    float headingX; // Unit heading; screen y grows downwards
+    float headingY;
+    float stopLine;       // Vehicles brake for a red light within STOP_DISTANCE past this
+    float turnStart;      // Turning vehicles start their turn on leaving the stop window here
+    float turnPoints[3];  // Indexed by TurnDirection; turning vehicles slow down near it
+    float lanes[2];       // Across-road position (x or y) of the through lane, then the right-turn lane
+} ApproachGeometry;
+
+// Indexed by Direction
+static const ApproachGeometry APPROACHES[] = {
+    {0.0f, -1.0f, -(INTERSECTION_Y + LANE_WIDTH + 40), -(INTERSECTION_Y + LANE_WIDTH),
+     {0, -(INTERSECTION_X - LANE_WIDTH - 40), -(INTERSECTION_X + LANE_WIDTH + 40)},
+     {INTERSECTION_X - LANE_WIDTH / 2 + 10, INTERSECTION_X - LANE_WIDTH / 2 - 30}},
+    {0.0f, 1.0f, INTERSECTION_Y - LANE_WIDTH - 40, INTERSECTION_Y - LANE_WIDTH,
+     {0, INTERSECTION_X + LANE_WIDTH + 40, INTERSECTION_X - LANE_WIDTH - 40},
+     {INTERSECTION_X + 10, INTERSECTION_X + 40}},
+    {1.0f, 0.0f, INTERSECTION_X - LANE_WIDTH - 40, INTERSECTION_X - LANE_WIDTH,
+     {0, INTERSECTION_Y + LANE_WIDTH + 40, INTERSECTION_Y - LANE_WIDTH - 40},
+     {INTERSECTION_Y - LANE_WIDTH / 2 + 10, INTERSECTION_Y - LANE_WIDTH / 2 - 30}},
+    {-1.0f, 0.0f, -(INTERSECTION_X + LANE_WIDTH + 40), -(INTERSECTION_X + LANE_WIDTH),
+     {0, -(INTERSECTION_Y - LANE_WIDTH - 40), -(INTERSECTION_Y + LANE_WIDTH + 40)},
+     {INTERSECTION_Y, INTERSECTION_Y + 40}}};
+// Where each approach leads after a left or a right turn
+static const Direction LEFT_OF[] = {DIRECTION_WEST, DIRECTION_EAST, DIRECTION_NORTH, DIRECTION_SOUTH};
+static const Direction RIGHT_OF[] = {DIRECTION_EAST, DIRECTION_WEST, DIRECTION_SOUTH, DIRECTION_NORTH};
+
+// Path of one kind of turn from one approach, sampled at every degree of progress
+typedef struct {
+    float startX; // Where the turn starts
+    float startY;
+    float dx[TURN_ARC_STEPS + 1]; // Offsets from the start
+    float dy[TURN_ARC_STEPS + 1];
+    float degreesPerPixel;   // Progress made per pixel travelled along the arc
+    Direction exitDirection; // Heading once the turn is complete
+} TurnArc;
+
+// Shared by every simulation; indexed by approach, then 0 = left turn, 1 = right turn
+static TurnArc turnArcs[4][2];
+static bool turnArcsBuilt = false;
+static SDL_SpinLock turnArcsLock;
 
 const SDL_Color VEHICLE_COLORS[] = {
     {223, 197, 123,255}, // REGULAR_CAR: Gold
@@ -16,27 +58,771 @@ const SDL_Color VEHICLE_COLORS[] = {
     {255, 69, 0, 255} // FIRE_TRUCK: Orange-Red
 };
 
-float getDistanceBetweenVehicles(Vehicle *v1, Vehicle *v2)
+float getDistanceBetweenVehicles(VehicleStore *store, int a, int b)
 {
-    float dx = v1->x - v2->x;
-    float dy = v1->y - v2->y;
+    float dx = store->x[a] - store->x[b];
+    float dy = store->y[a] - store->y[b];
     return sqrt(dx * dx + dy * dy);
 }
 
-int getVehicleLane(Vehicle *vehicle)
+int getVehicleLane(VehicleStore *store, int index)
 {
-    if (vehicle->direction == DIRECTION_NORTH || vehicle->direction == DIRECTION_SOUTH)
+    if (store->direction[index] == DIRECTION_NORTH || store->direction[index] == DIRECTION_SOUTH)
     {
-        return (vehicle->x < INTERSECTION_X) ? 0 : 1;
+        return (store->x[index] < INTERSECTION_X) ? 0 : 1;
     }
     else
     {
-        return (vehicle->y < INTERSECTION_Y) ? 2 : 3;
+        return (store->y[index] < INTERSECTION_Y) ? 2 : 3;
     }
 }
 
-void initializeTrafficLights(TrafficLight *lights)
+// Grows every array to newCapacity slots and puts the new ids on the free list
+static void growVehicleStore(VehicleStore *store, int newCapacity)
 {
+    store->x = (float *)realloc(store->x, newCapacity * sizeof(float));
+    store->y = (float *)realloc(store->y, newCapacity * sizeof(float));
+    store->speed = (float *)realloc(store->speed, newCapacity * sizeof(float));
+    store->state = (VehicleState *)realloc(store->state, newCapacity * sizeof(VehicleState));
+    store->direction = (Direction *)realloc(store->direction, newCapacity * sizeof(Direction));
+    store->type = (VehicleType *)realloc(store->type, newCapacity * sizeof(VehicleType));
+    store->ids = (int *)realloc(store->ids, newCapacity * sizeof(int));
+    store->turnDirection = (TurnDirection *)realloc(store->turnDirection, newCapacity * sizeof(TurnDirection));
+    store->turnAngle = (float *)realloc(store->turnAngle, newCapacity * sizeof(float));
+    store->isInRightLane = (bool *)realloc(store->isInRightLane, newCapacity * sizeof(bool));
+    store->canSkipLight = (bool *)realloc(store->canSkipLight, newCapacity * sizeof(bool));
+    store->waitMs = (Uint32 *)realloc(store->waitMs, newCapacity * sizeof(Uint32));
+    store->denseIndex = (int *)realloc(store->denseIndex, newCapacity * sizeof(int));
+    store->generations = (Uint32 *)realloc(store->generations, newCapacity * sizeof(Uint32));
+    store->leaders = (VehicleHandle *)realloc(store->leaders, newCapacity * sizeof(VehicleHandle));
+    store->freeIds = (int *)realloc(store->freeIds, newCapacity * sizeof(int));
+
+    // Push the new ids in reverse so the lowest id is handed out first
+    for (int id = newCapacity - 1; id >= store->capacity; id--)
+    {
+        store->denseIndex[id] = -1;
+        store->generations[id] = 0;
+        store->leaders[id].id = -1;
+        store->leaders[id].generation = 0;
+        store->freeIds[store->freeCount++] = id;
+    }
+    store->capacity = newCapacity;
+}
+
+void initVehicleStore(VehicleStore *store, int maxVehicles)
+{
+    memset(store, 0, sizeof(VehicleStore));
+    store->maxVehicles = maxVehicles;
+    growVehicleStore(store, (maxVehicles < VEHICLE_STORE_INITIAL_CAPACITY) ? maxVehicles : VEHICLE_STORE_INITIAL_CAPACITY);
+}
+
+void freeVehicleStore(VehicleStore *store)
+{
+    free(store->x);
+    free(store->y);
+    free(store->speed);
+    free(store->state);
+    free(store->direction);
+    free(store->type);
+    free(store->ids);
+    free(store->turnDirection);
+    free(store->turnAngle);
+    free(store->isInRightLane);
+    free(store->canSkipLight);
+    free(store->waitMs);
+    free(store->denseIndex);
+    free(store->generations);
+    free(store->leaders);
+    free(store->freeIds);
+    memset(store, 0, sizeof(VehicleStore));
+}
+
+// Claims an id off the free list and appends a slot for it at the end of the
+// dense arrays. Returns the dense index, or -1 when the store is full.
+int allocateVehicleSlot(VehicleStore *store)
+{
+    if (store->freeCount == 0)
+    {
+        if (store->capacity >= store->maxVehicles)
+        {
+            return -1;
+        }
+        int newCapacity = store->capacity * 2;
+        growVehicleStore(store, (newCapacity < store->maxVehicles) ? newCapacity : store->maxVehicles);
+    }
+    int id = store->freeIds[--store->freeCount];
+    int index = store->count++;
+    store->ids[index] = id;
+    store->denseIndex[id] = index;
+    store->leaders[id].id = -1; // Assigned when the lane index is next rebuilt
+    return index;
+}
+
+static void moveVehicle(VehicleStore *store, int from, int to)
+{
+    store->x[to] = store->x[from];
+    store->y[to] = store->y[from];
+    store->speed[to] = store->speed[from];
+    store->state[to] = store->state[from];
+    store->direction[to] = store->direction[from];
+    store->type[to] = store->type[from];
+    store->ids[to] = store->ids[from];
+    store->turnDirection[to] = store->turnDirection[from];
+    store->turnAngle[to] = store->turnAngle[from];
+    store->isInRightLane[to] = store->isInRightLane[from];
+    store->canSkipLight[to] = store->canSkipLight[from];
+    store->waitMs[to] = store->waitMs[from];
+    store->denseIndex[store->ids[to]] = to;
+}
+
+// Removes the vehicle at a dense index by moving the last vehicle into its place.
+// Its id is recycled with a new generation so outstanding handles go stale.
+void releaseVehicleSlot(VehicleStore *store, int index)
+{
+    int id = store->ids[index];
+    int last = store->count - 1;
+    if (index != last)
+    {
+        moveVehicle(store, last, index);
+    }
+    store->count--;
+    store->denseIndex[id] = -1;
+    store->generations[id]++;
+    store->freeIds[store->freeCount++] = id;
+}
+
+// Spawns a new vehicle into a free slot without touching the heap.
+// Returns the dense index, or -1 when the store is full.
+int spawnVehicle(VehicleStore *store, Direction direction, RandomStream *random)
+{
+    int index = allocateVehicleSlot(store);
+    if (index < 0)
+    {
+        return -1;
+    }
+    Vehicle vehicle;
+    initVehicle(&vehicle, direction, random);
+    storeVehicle(store, index, &vehicle);
+    return index;
+}
+
+// Spawns a vehicle described by a spawn record, e.g. one produced by the generator,
+// at the simulation's cruising speed for its type.
+// Returns the dense index, or -1 when the store is full.
+int spawnVehicleFromRecord(Simulation *sim, const SpawnRecord *record)
+{
+    VehicleStore *store = &sim->vehicles;
+    int index = allocateVehicleSlot(store);
+    if (index < 0)
+    {
+        return -1;
+    }
+    Vehicle vehicle;
+    setupVehicle(&vehicle, (Direction)record->direction, (VehicleType)record->type, (TurnDirection)record->turnDirection);
+    vehicle.speed = sim->parameters.speeds[vehicle.type];
+    storeVehicle(store, index, &vehicle);
+    return index;
+}
+
+void makeSpawnRecord(SpawnRecord *record, const Vehicle *vehicle, Uint32 timestamp)
+{
+    record->timestamp = timestamp;
+    record->direction = (Uint8)vehicle->direction;
+    record->type = (Uint8)vehicle->type;
+    record->turnDirection = (Uint8)vehicle->turnDirection;
+    record->lane = (vehicle->turnDirection == TURN_RIGHT) ? 1 : 0;
+}
+
+VehicleHandle getVehicleHandle(VehicleStore *store, int index)
+{
+    VehicleHandle handle;
+    handle.id = store->ids[index];
+    handle.generation = store->generations[handle.id];
+    return handle;
+}
+
+// Returns the current dense index of the vehicle, or -1 if it has since been removed
+int resolveVehicleHandle(VehicleStore *store, VehicleHandle handle)
+{
+    if (handle.id < 0 || store->generations[handle.id] != handle.generation)
+    {
+        return -1;
+    }
+    return store->denseIndex[handle.id];
+}
+
+// Scatters a vehicle record into an allocated slot of the store's arrays
+void storeVehicle(VehicleStore *store, int index, const Vehicle *vehicle)
+{
+    store->x[index] = vehicle->x;
+    store->y[index] = vehicle->y;
+    store->speed[index] = vehicle->speed;
+    store->state[index] = vehicle->state;
+    store->direction[index] = vehicle->direction;
+    store->type[index] = vehicle->type;
+    store->turnDirection[index] = vehicle->turnDirection;
+    store->turnAngle[index] = vehicle->turnAngle;
+    store->isInRightLane[index] = vehicle->isInRightLane;
+    store->canSkipLight[index] = vehicle->canSkipLight;
+    store->waitMs[index] = 0;
+}
+
+SDL_Rect getVehicleRect(VehicleStore *store, int index)
+{
+    SDL_Rect rect;
+    rect.x = (int)store->x[index];
+    rect.y = (int)store->y[index];
+    if (store->direction[index] == DIRECTION_NORTH || store->direction[index] == DIRECTION_SOUTH)
+    {
+        rect.w = VEHICLE_WIDTH;
+        rect.h = VEHICLE_LENGTH;
+    }
+    else
+    {
+        rect.w = VEHICLE_LENGTH;
+        rect.h = VEHICLE_WIDTH;
+    }
+    return rect;
+}
+
+void initSimulationClock(SimulationClock *clock, Uint32 tickMs)
+{
+    clock->tickMs = tickMs;
+    clock->now = 0;
+    clock->ticks = 0;
+}
+
+void advanceSimulationClock(SimulationClock *clock)
+{
+    clock->ticks++;
+    clock->now = clock->ticks * clock->tickMs;
+}
+
+// Bin of a wait of the given whole seconds. Past the linear range, the octave
+// [2^k, 2^(k+1)) s is split into WAIT_HISTOGRAM_SUB_BINS equal bins.
+static int waitHistogramBin(Uint32 seconds)
+{
+    if (seconds < WAIT_HISTOGRAM_LINEAR_BINS)
+    {
+        return (int)seconds;
+    }
+    int octave = 0; // k - log2(WAIT_HISTOGRAM_LINEAR_BINS)
+    while ((seconds >> octave) >= 2 * WAIT_HISTOGRAM_LINEAR_BINS)
+    {
+        octave++;
+    }
+    // Width of a bin in this octave, in seconds, is 2^(octave + 1)
+    int sub = (int)(seconds >> (octave + 1)) - WAIT_HISTOGRAM_SUB_BINS;
+    return WAIT_HISTOGRAM_LINEAR_BINS + octave * WAIT_HISTOGRAM_SUB_BINS + sub;
+}
+
+// Upper edge of a bin in seconds
+static double waitHistogramBinEnd(int bin)
+{
+    if (bin < WAIT_HISTOGRAM_LINEAR_BINS)
+    {
+        return bin + 1;
+    }
+    int octave = (bin - WAIT_HISTOGRAM_LINEAR_BINS) / WAIT_HISTOGRAM_SUB_BINS;
+    int sub = (bin - WAIT_HISTOGRAM_LINEAR_BINS) % WAIT_HISTOGRAM_SUB_BINS;
+    return (double)(WAIT_HISTOGRAM_SUB_BINS + sub + 1) * (2 << octave);
+}
+
+void addWaitSample(WaitHistogram *histogram, Uint32 waitMs)
+{
+    histogram->counts[waitHistogramBin(waitMs / 1000)]++;
+    histogram->samples++;
+    histogram->totalMs += waitMs;
+    if (waitMs > histogram->maxMs)
+    {
+        histogram->maxMs = waitMs;
+    }
+}
+
+void mergeWaitHistograms(WaitHistogram *into, const WaitHistogram *from)
+{
+    for (int i = 0; i < WAIT_HISTOGRAM_BINS; i++)
+    {
+        into->counts[i] += from->counts[i];
+    }
+    into->samples += from->samples;
+    into->totalMs += from->totalMs;
+    if (from->maxMs > into->maxMs)
+    {
+        into->maxMs = from->maxMs;
+    }
+}
+
+// Returns the wait in seconds below which the given fraction of vehicles fall,
+// resolved to the upper edge of its histogram bin but never above the longest wait
+double waitPercentile(const WaitHistogram *histogram, double fraction)
+{
+    if (histogram->samples == 0)
+    {
+        return 0;
+    }
+    Uint64 target = (Uint64)(fraction * histogram->samples);
+    Uint64 seen = 0;
+    double maxSeconds = histogram->maxMs / 1000.0;
+    for (int i = 0; i < WAIT_HISTOGRAM_BINS; i++)
+    {
+        seen += histogram->counts[i];
+        if (seen > target)
+        {
+            double end = waitHistogramBinEnd(i);
+            return (end < maxSeconds) ? end : maxSeconds;
+        }
+    }
+    return maxSeconds;
+}
+
+double meanWait(const WaitHistogram *histogram)
+{
+    return (histogram->samples > 0) ? histogram->totalMs / 1000.0 / histogram->samples : 0;
+}
+
+void defaultSimulationParameters(SimulationParameters *parameters)
+{
+    parameters->cycleMs = DEFAULT_SIGNAL_CYCLE_MS;
+    parameters->priorityWindowMs = DEFAULT_PRIORITY_WINDOW_MS;
+    parameters->congestionThreshold = DEFAULT_CONGESTION_THRESHOLD;
+    memcpy(parameters->speeds, DEFAULT_SPEEDS, sizeof(parameters->speeds));
+}
+
+// Samples the quarter circle of every turn, so turning vehicles follow it by
+// table lookup. A turn starts in its lane where the stop window ends and its
+// radius r takes it exactly onto the exit approach's through lane. It sweeps from
+// the approach heading h to the exit heading e along r * (h * sin(a) + e * (1 - cos(a))).
+// The first call builds the shared table; later calls return at once.
+static void buildTurnArcs(void)
+{
+    SDL_AtomicLock(&turnArcsLock);
+    if (turnArcsBuilt)
+    {
+        SDL_AtomicUnlock(&turnArcsLock);
+        return;
+    }
+    for (int direction = 0; direction < 4; direction++)
+    {
+        const ApproachGeometry *entry = &APPROACHES[direction];
+        for (int turn = 0; turn < 2; turn++)
+        {
+            TurnArc *arc = &turnArcs[direction][turn];
+            arc->exitDirection = (turn == 0) ? LEFT_OF[direction] : RIGHT_OF[direction];
+            const ApproachGeometry *exit = &APPROACHES[arc->exitDirection];
+            // Left turners keep to the through lane, right turners to the right-turn lane
+            float lane = entry->lanes[turn];
+            // Headings are axis-aligned, so the exit lane's across-road position is
+            // a position along the entry approach
+            float radius = (entry->headingX + entry->headingY) * exit->lanes[0] - entry->turnStart;
+            arc->startX = (entry->headingX != 0) ? entry->headingX * entry->turnStart : lane;
+            arc->startY = (entry->headingY != 0) ? entry->headingY * entry->turnStart : lane;
+            arc->degreesPerPixel = (float)(180.0 / (M_PI * radius));
+            for (int step = 0; step <= TURN_ARC_STEPS; step++)
+            {
+                double radians = step * (M_PI / 2) / TURN_ARC_STEPS;
+                float along = (float)(radius * sin(radians));
+                float across = (float)(radius * (1 - cos(radians)));
+                arc->dx[step] = entry->headingX * along + exit->headingX * across;
+                arc->dy[step] = entry->headingY * along + exit->headingY * across;
+            }
+        }
+    }
+    turnArcsBuilt = true;
+    SDL_AtomicUnlock(&turnArcsLock);
+}
+
+// Offset from the start of the turn after the given progress in degrees,
+// interpolated between the two nearest samples
+static void turnArcOffset(const TurnArc *arc, float progress, float *dx, float *dy)
+{
+    int step = (int)progress;
+    if (step >= TURN_ARC_STEPS)
+    {
+        *dx = arc->dx[TURN_ARC_STEPS];
+        *dy = arc->dy[TURN_ARC_STEPS];
+        return;
+    }
+    float fraction = progress - step;
+    *dx = arc->dx[step] + (arc->dx[step + 1] - arc->dx[step]) * fraction;
+    *dy = arc->dy[step] + (arc->dy[step + 1] - arc->dy[step]) * fraction;
+}
+
+// Sets up an empty intersection at time zero with room for maxVehicles vehicles
+void initSimulation(Simulation *sim, int maxVehicles, Uint32 tickMs)
+{
+    memset(sim, 0, sizeof(Simulation));
+    defaultSimulationParameters(&sim->parameters);
+    initSimulationClock(&sim->clock, tickMs);
+    initVehicleStore(&sim->vehicles, maxVehicles);
+    initializeTrafficLights(sim);
+    buildTurnArcs();
+    wakeAllVehicles(sim);
+    sim->stats.startTime = sim->clock.now;
+    for (int i = 0; i < 4; i++)
+    {
+        initQueue(&sim->laneQueues[i]);
+        reserveQueue(&sim->laneQueues[i], LANE_QUEUE_CAPACITY);
+    }
+}
+
+static void freeLaneIndex(Simulation *sim)
+{
+    free(sim->laneBuffer);
+    free(sim->platoons);
+    free(sim->platoonMembers);
+    free(sim->platooned);
+    sim->laneBuffer = NULL;
+    sim->platoons = NULL;
+    sim->platoonMembers = NULL;
+    sim->platooned = NULL;
+    sim->platoonCount = 0;
+    sim->laneBufferCapacity = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        sim->laneVehicles[i] = NULL;
+        sim->vehiclesInLane[i] = 0;
+    }
+}
+
+void freeSimulation(Simulation *sim)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        freeQueue(&sim->laneQueues[i]);
+    }
+    freeLaneIndex(sim);
+    free(sim->asleep);
+    free(sim->sleepingBehind);
+    free(sim->sleepers);
+    free(sim->nextSleeper);
+    free(sim->previousSleeper);
+    sim->asleep = NULL;
+    sim->sleepingBehind = NULL;
+    sim->sleepers = NULL;
+    sim->nextSleeper = NULL;
+    sim->previousSleeper = NULL;
+    sim->sleepCapacity = 0;
+    freeVehicleStore(&sim->vehicles);
+}
+
+// Grows the wait lists to cover every vehicle id; the new ids start awake
+static void growSleepLists(Simulation *sim, int newCapacity)
+{
+    sim->asleep = (bool *)realloc(sim->asleep, newCapacity * sizeof(bool));
+    sim->sleepingBehind = (int *)realloc(sim->sleepingBehind, newCapacity * sizeof(int));
+    sim->sleepers = (int *)realloc(sim->sleepers, newCapacity * sizeof(int));
+    sim->nextSleeper = (int *)realloc(sim->nextSleeper, newCapacity * sizeof(int));
+    sim->previousSleeper = (int *)realloc(sim->previousSleeper, newCapacity * sizeof(int));
+    for (int id = sim->sleepCapacity; id < newCapacity; id++)
+    {
+        sim->asleep[id] = false;
+        sim->sleepers[id] = -1;
+    }
+    sim->sleepCapacity = newCapacity;
+}
+
+// Puts a stopped vehicle to sleep behind a leader, or at its light when leader is -1
+static void parkVehicle(Simulation *sim, int id, int leader, Direction direction)
+{
+    int *list = (leader >= 0) ? &sim->sleepers[leader] : &sim->lightSleepers[direction];
+    sim->asleep[id] = true;
+    sim->sleepingBehind[id] = leader;
+    sim->previousSleeper[id] = -1;
+    sim->nextSleeper[id] = *list;
+    if (*list >= 0)
+    {
+        sim->previousSleeper[*list] = id;
+    }
+    *list = id;
+}
+
+// Wakes a single vehicle, taking it off its wait list
+static void unparkVehicle(Simulation *sim, int id, Direction direction)
+{
+    int previous = sim->previousSleeper[id];
+    int next = sim->nextSleeper[id];
+    if (previous >= 0)
+    {
+        sim->nextSleeper[previous] = next;
+    }
+    else if (sim->sleepingBehind[id] >= 0)
+    {
+        sim->sleepers[sim->sleepingBehind[id]] = next;
+    }
+    else
+    {
+        sim->lightSleepers[direction] = next;
+    }
+    if (next >= 0)
+    {
+        sim->previousSleeper[next] = previous;
+    }
+    sim->asleep[id] = false;
+}
+
+// Wakes every vehicle on a wait list and empties it
+static void wakeSleepers(Simulation *sim, int *list)
+{
+    for (int id = *list; id >= 0; id = sim->nextSleeper[id])
+    {
+        sim->asleep[id] = false;
+    }
+    *list = -1;
+}
+
+// Empties every wait list, e.g. after the vehicles were replaced wholesale.
+// Waking is always safe: an awake vehicle that still cannot move goes back to sleep.
+void wakeAllVehicles(Simulation *sim)
+{
+    for (int id = 0; id < sim->sleepCapacity; id++)
+    {
+        sim->asleep[id] = false;
+        sim->sleepers[id] = -1;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        sim->lightSleepers[i] = -1;
+    }
+}
+
+static bool allVehiclesStopped(const VehicleStore *store)
+{
+    for (int i = 0; i < store->count; i++)
+    {
+        if (store->state[i] != STATE_STOPPED)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameSignals(const Simulation *sim, const SignalController *controller, const TrafficLightState *lights)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (sim->lights[i].state != lights[i])
+        {
+            return false;
+        }
+    }
+    return sim->controller.lastStateChangeTicks == controller->lastStateChangeTicks &&
+           sim->controller.currentPhase == controller->currentPhase &&
+           sim->controller.priorityMode == controller->priorityMode &&
+           sim->controller.priorityLane == controller->priorityLane &&
+           sim->controller.priorityStartTime == controller->priorityStartTime;
+}
+
+// How far a vehicle at (x, y) has come along the approach
+static float alongApproach(const ApproachGeometry *approach, float x, float y)
+{
+    return approach->headingX * x + approach->headingY * y;
+}
+
+// Whether a vehicle this far along the approach brakes when its light is red
+static bool inStopWindow(const ApproachGeometry *approach, float along)
+{
+    return along > approach->stopLine && along < approach->stopLine + STOP_DISTANCE;
+}
+
+// Moves each platoon member that simply carries on at its speed this tick,
+// exactly as updateVehicle would, and marks it so simulationStep skips it.
+// Members about to brake for a red light, slow down or start a turn, or leave
+// the road are left to updateVehicle. Must run after the signals are updated.
+static void advancePlatoons(Simulation *sim)
+{
+    VehicleStore *store = &sim->vehicles;
+    for (int p = 0; p < sim->platoonCount; p++)
+    {
+        const Platoon *platoon = &sim->platoons[p];
+        Direction direction = platoon->direction;
+        const ApproachGeometry *approach = &APPROACHES[direction];
+        bool red = sim->lights[direction].state == RED;
+        for (int m = platoon->first; m < platoon->first + platoon->count; m++)
+        {
+            int index = resolveVehicleHandle(store, sim->platoonMembers[m]);
+            int id = store->ids[index];
+            float speed = store->speed[index];
+            float x = store->x[index];
+            float y = store->y[index];
+            float along = alongApproach(approach, x, y);
+            if (red && !store->canSkipLight[index] && inStopWindow(approach, along))
+            {
+                continue;
+            }
+            if (store->turnDirection[index] != TURN_NONE && (along >= approach->turnStart || speed < 0.5f))
+            {
+                continue;
+            }
+            x += approach->headingX * speed;
+            y += approach->headingY * speed;
+            if (x < -100 || x > WINDOW_WIDTH + 100 ||
+                y < -100 || y > WINDOW_HEIGHT + 100)
+            {
+                continue;
+            }
+
+            if (x != store->x[index] || y != store->y[index])
+            {
+                wakeSleepers(sim, &sim->sleepers[id]);
+            }
+            store->x[index] = x;
+            store->y[index] = y;
+            if (store->state[index] == STATE_STOPPING)
+            {
+                store->waitMs[index] += sim->clock.tickMs;
+            }
+            sim->platooned[id] = true;
+        }
+    }
+}
+
+// Runs one tick of the pipeline: rebuild the lane index, update the signals,
+// move every vehicle once (cruising platoons first, as a unit), then update
+// statistics and advance the clock.
+// timings may be NULL; otherwise the time spent in each stage is added to it.
+void simulationStep(Simulation *sim, StageTimings *timings)
+{
+    VehicleStore *store = &sim->vehicles;
+    Statistics *stats = &sim->stats;
+    SimulationClock *clock = &sim->clock;
+    Uint64 stageStart = timings ? SDL_GetPerformanceCounter() : 0;
+    Uint64 stageEnd;
+
+    // A stopped vehicle that is still stopped after the tick has not moved
+    bool wasStopped = allVehiclesStopped(store);
+    SignalController controller = sim->controller;
+    TrafficLightState lights[4];
+    for (int i = 0; i < 4; i++)
+    {
+        lights[i] = sim->lights[i].state;
+    }
+
+    updateLanePositions(sim);
+    if (timings)
+    {
+        stageEnd = SDL_GetPerformanceCounter();
+        timings->laneIndex += stageEnd - stageStart;
+        stageStart = stageEnd;
+    }
+
+    updateTrafficLights(sim);
+    if (timings)
+    {
+        stageEnd = SDL_GetPerformanceCounter();
+        timings->signals += stageEnd - stageStart;
+        stageStart = stageEnd;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        if (sim->lights[i].state != lights[i])
+        {
+            wakeSleepers(sim, &sim->lightSleepers[i]);
+        }
+    }
+
+    advancePlatoons(sim);
+    // Vehicles update in dense order, which swap-removal reshuffles, so a run's
+    // results depend on it. A removed vehicle is replaced by the last one, which
+    // still needs its update.
+    for (int i = 0; i < store->count;)
+    {
+        int id = store->ids[i];
+        if (sim->platooned[id])
+        {
+            sim->platooned[id] = false; // Already moved with its platoon
+            i++;
+        }
+        else if (updateVehicle(sim, i))
+        {
+            i++;
+        }
+        else
+        {
+            stats->vehiclesPassed++;
+        }
+    }
+    if (timings)
+    {
+        stageEnd = SDL_GetPerformanceCounter();
+        timings->vehicles += stageEnd - stageStart;
+        stageStart = stageEnd;
+    }
+
+    sim->idle = wasStopped && allVehiclesStopped(store) && sameSignals(sim, &controller, lights);
+
+    float minutes = (clock->now - stats->startTime) / 60000.0f;
+    if (minutes > 0)
+    {
+        stats->vehiclesPerMinute = stats->vehiclesPassed / minutes;
+    }
+    advanceSimulationClock(clock);
+    if (timings)
+    {
+        timings->statistics += SDL_GetPerformanceCounter() - stageStart;
+    }
+}
+
+// Returns the simulated time at which the signal controller next acts on its
+// own, as long as the vehicles waiting at the lights do not change
+Uint32 nextSignalEvent(const Simulation *sim)
+{
+    const SignalController *controller = &sim->controller;
+    if (controller->priorityMode)
+    {
+        return controller->priorityStartTime + sim->parameters.priorityWindowMs;
+    }
+    return controller->lastStateChangeTicks + sim->parameters.cycleMs;
+}
+
+// Jumps over ticks that would only repeat an idle tick, stopping at the first
+// tick that reaches nextEvent (typically the next arrival or the end of the
+// run) or the next signal change. Skipped ticks have exactly the effect they
+// would have had when run: stopped vehicles keep waiting and the throughput
+// is updated. Returns the number of ticks skipped.
+Uint32 skipIdleTicks(Simulation *sim, Uint32 nextEvent)
+{
+    SimulationClock *clock = &sim->clock;
+    if (!sim->idle)
+    {
+        return 0;
+    }
+    Uint32 signalEvent = nextSignalEvent(sim);
+    Uint32 event = (signalEvent < nextEvent) ? signalEvent : nextEvent;
+    Uint32 eventTick = (Uint32)(((Uint64)event + clock->tickMs - 1) / clock->tickMs);
+    if (eventTick <= clock->ticks)
+    {
+        return 0;
+    }
+    Uint32 skipped = eventTick - clock->ticks;
+
+    VehicleStore *store = &sim->vehicles;
+    for (int i = 0; i < store->count; i++)
+    {
+        store->waitMs[i] += skipped * clock->tickMs;
+    }
+    // Statistics as the last skipped tick would have left them
+    clock->ticks = eventTick - 1;
+    clock->now = clock->ticks * clock->tickMs;
+    float minutes = (clock->now - sim->stats.startTime) / 60000.0f;
+    if (minutes > 0)
+    {
+        sim->stats.vehiclesPerMinute = sim->stats.vehiclesPassed / minutes;
+    }
+    advanceSimulationClock(clock);
+    return skipped;
+}
+
+void initializeTrafficLights(Simulation *sim)
+{
+    TrafficLight *lights = sim->lights;
+    sim->controller = (SignalController){
+        .lastStateChangeTicks = 0,
+        .currentPhase = 0,
+        .priorityMode = false,
+        .priorityLane = -1,
+        .priorityStartTime = 0};
     lights[0] = (TrafficLight){
         .state = RED,
         .timer = 0,
@@ -59,14 +845,14 @@ void initializeTrafficLights(TrafficLight *lights)
         .direction = DIRECTION_WEST};
 }
 
-void updateTrafficLights(TrafficLight *lights)
+void updateTrafficLights(Simulation *sim)
 {
-    static Uint32 lastStateChangeTicks = 0;
-    static int currentPhase = 0;
-    static bool priorityMode = false;
-    static int priorityLane = -1;
-    static Uint32 priorityStartTime = 0;
-    Uint32 currentTicks = SDL_GetTicks();
+    TrafficLight *lights = sim->lights;
+    VehicleStore *store = &sim->vehicles;
+    SignalController *controller = &sim->controller;
+    LanePosition *const *laneVehicles = sim->laneVehicles;
+    const int *vehiclesInLane = sim->vehiclesInLane;
+    Uint32 currentTicks = sim->clock.now;
 
     // Check for priority conditions (special vehicles or congestion)
     int priorityLaneCandidate = -1;
@@ -78,13 +864,13 @@ void updateTrafficLights(TrafficLight *lights)
     {
         for (int j = 0; j < vehiclesInLane[i]; j++)
         {
-            Vehicle *vehicle = laneVehicles[i][j].vehicle;
-            if (vehicle && (vehicle->type == AMBULANCE || vehicle->type == POLICE_CAR || vehicle->type == FIRE_TRUCK))
+            int vehicle = resolveVehicleHandle(store, laneVehicles[i][j].vehicle);
+            if (vehicle >= 0 && (store->type[vehicle] == AMBULANCE || store->type[vehicle] == POLICE_CAR || store->type[vehicle] == FIRE_TRUCK))
             {
                 hasSpecialVehicle = true;
                 priorityLaneCandidate = i;
                 // Allow emergency vehicles to pass red lights
-                vehicle->canSkipLight = true;
+                store->canSkipLight[vehicle] = true;
                 break;
             }
         }
@@ -100,15 +886,15 @@ void updateTrafficLights(TrafficLight *lights)
     }
 
     // Determine if we should enter or maintain priority mode
-    if (hasSpecialVehicle || (maxWaitingVehicles > 5 && !priorityMode))
+    if (hasSpecialVehicle || (maxWaitingVehicles > sim->parameters.congestionThreshold && !controller->priorityMode))
     {
-        priorityMode = true;
-        priorityLane = priorityLaneCandidate;
-        priorityStartTime = currentTicks;
+        controller->priorityMode = true;
+        controller->priorityLane = priorityLaneCandidate;
+        controller->priorityStartTime = currentTicks;
 
         // Fix: explicitly set lights based on direction rather than using modulo
         // This ensures correct pairing of traffic lights
-        if (priorityLane == 0 || priorityLane == 1)
+        if (controller->priorityLane == 0 || controller->priorityLane == 1)
         { // North or South lane has priority
             // Give green to North-South, red to East-West
             lights[DIRECTION_NORTH].state = GREEN;
@@ -125,20 +911,21 @@ void updateTrafficLights(TrafficLight *lights)
             lights[DIRECTION_WEST].state = GREEN;
         }
 
-        printf("Priority mode activated at %d ms. Lane %d prioritized. Reason: %s\n",
-               currentTicks, priorityLane, hasSpecialVehicle ? "Emergency Vehicle" : "Congestion");
-        lastStateChangeTicks = currentTicks; // Reset the state change timer
+        if (!sim->quiet)
+            printf("Priority mode activated at %d ms. Lane %d prioritized. Reason: %s\n",
+                   currentTicks, controller->priorityLane, hasSpecialVehicle ? "Emergency Vehicle" : "Congestion");
+        controller->lastStateChangeTicks = currentTicks; // Reset the state change timer
     }
-    // Exit priority mode after 10 seconds if no special vehicles remain
-    else if (priorityMode && currentTicks - priorityStartTime >= 10000)
+    // Exit priority mode after the priority window if no special vehicles remain
+    else if (controller->priorityMode && currentTicks - controller->priorityStartTime >= sim->parameters.priorityWindowMs)
     {
         bool stillHasSpecialVehicle = false;
 
         // Check if special vehicles are still present in the priority lane
-        for (int j = 0; j < vehiclesInLane[priorityLane]; j++)
+        for (int j = 0; j < vehiclesInLane[controller->priorityLane]; j++)
         {
-            Vehicle *vehicle = laneVehicles[priorityLane][j].vehicle;
-            if (vehicle && (vehicle->type == AMBULANCE || vehicle->type == POLICE_CAR || vehicle->type == FIRE_TRUCK))
+            int vehicle = resolveVehicleHandle(store, laneVehicles[controller->priorityLane][j].vehicle);
+            if (vehicle >= 0 && (store->type[vehicle] == AMBULANCE || store->type[vehicle] == POLICE_CAR || store->type[vehicle] == FIRE_TRUCK))
             {
                 stillHasSpecialVehicle = true;
                 break;
@@ -147,23 +934,24 @@ void updateTrafficLights(TrafficLight *lights)
 
         if (!stillHasSpecialVehicle)
         {
-            priorityMode = false;
-            printf("Priority mode deactivated at %d ms. Returning to normal cycle.\n", currentTicks);
+            controller->priorityMode = false;
+            if (!sim->quiet)
+                printf("Priority mode deactivated at %d ms. Returning to normal cycle.\n", currentTicks);
         }
         else
         {
             // Extend priority mode
-            priorityStartTime = currentTicks;
+            controller->priorityStartTime = currentTicks;
         }
     }
 
     // Normal traffic light cycle if not in priority mode
-    if (!priorityMode && currentTicks - lastStateChangeTicks >= 5000)
+    if (!controller->priorityMode && currentTicks - controller->lastStateChangeTicks >= sim->parameters.cycleMs)
     {
         // Toggle between phases (0 = N/S green, E/W red; 1 = N/S red, E/W green)
-        currentPhase = 1 - currentPhase;
+        controller->currentPhase = 1 - controller->currentPhase;
 
-        if (currentPhase == 0)
+        if (controller->currentPhase == 0)
         { // North/South green, East/West red
             lights[DIRECTION_NORTH].state = GREEN;
             lights[DIRECTION_SOUTH].state = GREEN;
@@ -178,8 +966,9 @@ void updateTrafficLights(TrafficLight *lights)
             lights[DIRECTION_WEST].state = GREEN;
         }
 
-        lastStateChangeTicks = currentTicks;
-        printf("State changed at %d ms. Phase: %d, Reason: Normal Cycle\n", currentTicks, currentPhase);
+        controller->lastStateChangeTicks = currentTicks;
+        if (!sim->quiet)
+            printf("State changed at %d ms. Phase: %d, Reason: Normal Cycle\n", currentTicks, controller->currentPhase);
     }
 
     // Reset canSkipLight flag for non-emergency vehicles
@@ -187,70 +976,77 @@ void updateTrafficLights(TrafficLight *lights)
     // {
     //     for (int j = 0; j < vehiclesInLane[i]; j++)
     //     {
-    //         Vehicle *vehicle = laneVehicles[i][j].vehicle;
-    //         if (vehicle && vehicle->type == REGULAR_CAR)
+    //         int vehicle = resolveVehicleHandle(store, laneVehicles[i][j].vehicle);
+    //         if (vehicle >= 0 && store->type[vehicle] == REGULAR_CAR)
     //         {
-    //             vehicle->canSkipLight = false;
+    //             store->canSkipLight[vehicle] = false;
     //         }
     //     }
     // }
 }
 
-Vehicle *createVehicle(Direction direction)
+Vehicle *createVehicle(Direction direction, RandomStream *random)
 {
     Vehicle *vehicle = (Vehicle *)malloc(sizeof(Vehicle));
-    vehicle->direction = direction;
+    initVehicle(vehicle, direction, random);
+    return vehicle;
+}
+
+// Fills in a freshly spawned vehicle in place, picking its type and turn at random
+void initVehicle(Vehicle *vehicle, Direction direction, RandomStream *random)
+{
+    VehicleType type;
+    TurnDirection turnDirection;
 
     // Set vehicle type with probabilities
-    int typeRoll = rand() % 100;
+    int typeRoll = (int)randomBelow(random, 100);
     if (typeRoll < 5)
     {
-        vehicle->type = AMBULANCE;
+        type = AMBULANCE;
     }
     else if (typeRoll < 10)
     {
-        vehicle->type = POLICE_CAR;
+        type = POLICE_CAR;
     }
     else if (typeRoll < 15)
     {
-        vehicle->type = FIRE_TRUCK;
+        type = FIRE_TRUCK;
     }
     else
     {
-        vehicle->type = REGULAR_CAR;
+        type = REGULAR_CAR;
     }
 
-    vehicle->active = true;
-    vehicle->canSkipLight = false; // Initialize canSkipLight to false
-    // Set speed based on vehicle type
-    switch (vehicle->type)
-    {
-    case AMBULANCE:
-    case POLICE_CAR:
-        vehicle->speed = 4.0f;
-        break;
-    case FIRE_TRUCK:
-        vehicle->speed = 3.5f;
-        break;
-    default:
-        vehicle->speed = 2.0f;
-    }
-
-    vehicle->state = STATE_MOVING;
-    vehicle->turnAngle = 0.0f;
-    vehicle->turnProgress = 0.0f;
-
     // 30% chance to turn
-    int turnChance = rand() % 100;
+    int turnChance = (int)randomBelow(random, 100);
     if (turnChance < 30)
     {
-        vehicle->turnDirection = (turnChance < 15) ? TURN_LEFT : TURN_RIGHT;
+        turnDirection = (turnChance < 15) ? TURN_LEFT : TURN_RIGHT;
     }
     else
     {
-        vehicle->turnDirection = TURN_NONE;
+        turnDirection = TURN_NONE;
     }
 
+    setupVehicle(vehicle, direction, type, turnDirection);
+}
+
+// Fills in a vehicle with the given properties at its approach's spawn point
+void setupVehicle(Vehicle *vehicle, Direction direction, VehicleType type, TurnDirection turnDirection)
+{
+    memset(vehicle, 0, sizeof(Vehicle));
+    vehicle->direction = direction;
+    vehicle->type = type;
+    vehicle->turnDirection = turnDirection;
+
+    vehicle->active = true;
+    // Set speed based on vehicle type
+    vehicle->speed = DEFAULT_SPEEDS[type];
+
+    vehicle->state = STATE_MOVING;
+    vehicle->turnAngle = 0.0f;
+    vehicle->turnProgress = 0.0f;
+
     // Set dimensions based on direction
     if (direction == DIRECTION_NORTH || direction == DIRECTION_SOUTH)
     {
@@ -263,444 +1059,383 @@ Vehicle *createVehicle(Direction direction)
         vehicle->rect.h = 20; // height
     }
 
+    // Right turners get their own lane and may turn on red
+    float lane = APPROACHES[direction].lanes[turnDirection == TURN_RIGHT ? 1 : 0];
+    vehicle->canSkipLight = (turnDirection == TURN_RIGHT);
+
     // Fixed spawn positions for each direction
     switch (direction)
     {
     case DIRECTION_NORTH: // Spawns at bottom, moves up
-        if (vehicle->turnDirection == TURN_RIGHT)
-        {
-            vehicle->canSkipLight = true;
-            vehicle->x = INTERSECTION_X - LANE_WIDTH / 2 - 30;
-        }
-        else
-        {
-            vehicle->x = INTERSECTION_X - LANE_WIDTH / 2 + 10;
-        }
+        vehicle->x = lane;
         vehicle->y = WINDOW_HEIGHT - vehicle->rect.h;
         break;
 
     case DIRECTION_SOUTH: // Spawns at top, moves down
-        if (vehicle->turnDirection == TURN_RIGHT)
-        {
-            vehicle->canSkipLight = true;
-            vehicle->x = INTERSECTION_X + 40;
-        }
-        else
-        {
-            vehicle->x = INTERSECTION_X + 10;
-        }
+        vehicle->x = lane;
         vehicle->y = 0;
         break;
 
     case DIRECTION_EAST: // Spawns at left, moves right
-        if (vehicle->turnDirection == TURN_RIGHT)
-        {
-            vehicle->canSkipLight = true;
-            vehicle->y = INTERSECTION_Y - LANE_WIDTH / 2 - 40 + 10;
-        }
-        else
-        {
-            vehicle->y = INTERSECTION_Y - LANE_WIDTH / 2 + 10;
-        }
         vehicle->x = 0;
+        vehicle->y = lane;
         break;
 
     case DIRECTION_WEST: // Spawns at right, moves left
         vehicle->x = WINDOW_WIDTH - vehicle->rect.w;
-        if (vehicle->turnDirection == TURN_RIGHT)
-        {
-            vehicle->canSkipLight = true;
-            vehicle->y = INTERSECTION_Y + 40;
-        }
-        else
-        {
-            vehicle->y = INTERSECTION_Y;
-        }
+        vehicle->y = lane;
         vehicle->isInRightLane = (vehicle->y > INTERSECTION_Y);
         break;
     }
 
     vehicle->rect.x = (int)vehicle->x;
     vehicle->rect.y = (int)vehicle->y;
-
-    return vehicle;
 }
 
-void updateVehicle(Vehicle *vehicle, TrafficLight *lights)
+// Advances one vehicle by a tick. Returns false if the vehicle left the screen,
+// in which case it was removed and the last vehicle now occupies this index.
+bool updateVehicle(Simulation *sim, int index)
 {
-    if (!vehicle->active)
-        return;
+    VehicleStore *store = &sim->vehicles;
+    const TrafficLight *lights = sim->lights;
+    int id = store->ids[index];
 
-    float stopLine = 0;
-    bool shouldStop = false;
-    float stopDistance = 40.0f;
-    float turnPoint = 0;
-    const float MIN_VEHICLE_DISTANCE = 40.0f;
-    bool hasEmergencyPriority = (vehicle->type != REGULAR_CAR);
-
-    // Calculate stop line based on direction
-    switch (vehicle->direction)
-    {
-    case DIRECTION_NORTH:
-        stopLine = INTERSECTION_Y + LANE_WIDTH + 40;
-        // Check for vehicles ahead in the same lane
-        for (int i = 0; i < vehiclesInLane[getVehicleLane(vehicle)]; i++)
+    if (sim->asleep[id])
+    {
+        // Nothing that could let the vehicle move has changed, so this tick would
+        // leave it stopped exactly where it is
+        int heldBy = sim->sleepingBehind[id];
+        if (heldBy < 0 || store->leaders[id].id == heldBy)
         {
-            Vehicle *other = laneVehicles[getVehicleLane(vehicle)][i].vehicle;
-            if (other != vehicle && other->direction == vehicle->direction)
-            {
-                float distance = vehicle->y - other->y;
-                if (distance > 0 && distance < MIN_VEHICLE_DISTANCE && !vehicle->canSkipLight)
-                {
-                    shouldStop = true;
-                    stopLine = other->y + other->rect.h + 5;
-                    break;
-                }
-            }
+            store->waitMs[index] += sim->clock.tickMs;
+            return true;
         }
+        // Another vehicle cut in ahead, e.g. a right-turner passing the queue.
+        // It may leave before this vehicle's turn, so run the full update.
+        unparkVehicle(sim, id, store->direction[index]);
+    }
 
-        switch (vehicle->turnDirection)
-        {
-        case TURN_LEFT:
-            turnPoint = INTERSECTION_X - LANE_WIDTH - 40;
-            break;
-        case TURN_RIGHT:
-            turnPoint = INTERSECTION_X + LANE_WIDTH + 40;
-            break;
-        }
-        break;
-    case DIRECTION_SOUTH:
-        stopLine = INTERSECTION_Y - LANE_WIDTH - 40;
-        for (int i = 0; i < vehiclesInLane[getVehicleLane(vehicle)]; i++)
-        {
-            Vehicle *other = laneVehicles[getVehicleLane(vehicle)][i].vehicle;
-            if (other != vehicle && other->direction == vehicle->direction)
-            {
-                float distance = other->y - vehicle->y;
-                if (distance > 0 && distance < MIN_VEHICLE_DISTANCE && !vehicle->canSkipLight)
-                {
-                    shouldStop = true;
-                    stopLine = other->y - vehicle->rect.h - 5;
-                    break;
-                }
-            }
-        }
-        switch (vehicle->turnDirection)
-        {
-        case TURN_LEFT:
-            turnPoint = INTERSECTION_X + LANE_WIDTH + 40;
-            break;
-        case TURN_RIGHT:
-            turnPoint = INTERSECTION_X - LANE_WIDTH - 40;
-            break;
-        }
-        break;
-    case DIRECTION_EAST:
-        stopLine = INTERSECTION_X - LANE_WIDTH - 40;
-        for (int i = 0; i < vehiclesInLane[getVehicleLane(vehicle)]; i++)
-        {
-            Vehicle *other = laneVehicles[getVehicleLane(vehicle)][i].vehicle;
-            if (other != vehicle && other->direction == vehicle->direction)
-            {
-                float distance = other->x - vehicle->x;
-                if (distance > 0 && distance < MIN_VEHICLE_DISTANCE && !vehicle->canSkipLight)
-                {
-                    shouldStop = true;
-                    stopLine = other->x - vehicle->rect.w - 5;
-                    break;
-                }
-            }
-        }
-        switch (vehicle->turnDirection)
-        {
-        case TURN_LEFT:
-            turnPoint = INTERSECTION_Y + LANE_WIDTH + 40;
-            break;
-        case TURN_RIGHT:
-            turnPoint = INTERSECTION_Y - LANE_WIDTH - 40;
-            break;
-        }
-        break;
-    case DIRECTION_WEST:
-        stopLine = INTERSECTION_X + LANE_WIDTH + 40;
-        for (int i = 0; i < vehiclesInLane[getVehicleLane(vehicle)]; i++)
-        {
-            Vehicle *other = laneVehicles[getVehicleLane(vehicle)][i].vehicle;
-            if (other != vehicle && other->direction == vehicle->direction)
-            {
-                float distance = vehicle->x - other->x;
-                if (distance > 0 && distance < MIN_VEHICLE_DISTANCE && !vehicle->canSkipLight)
-                {
-                    shouldStop = true;
-                    stopLine = other->x + other->rect.w + 5;
-                    break;
-                }
-            }
-        }
-        switch (vehicle->turnDirection)
+    // Work on local copies of the hot fields and write them back at the end
+    float x = store->x[index];
+    float y = store->y[index];
+    float speed = store->speed[index];
+    VehicleState state = store->state[index];
+    Direction direction = store->direction[index];
+    TurnDirection turnDirection = store->turnDirection[index];
+    bool canSkipLight = store->canSkipLight[index];
+
+    const ApproachGeometry *approach = &APPROACHES[direction];
+    float along = alongApproach(approach, x, y);
+    bool shouldStop = false;
+    // Leaders come from the sorted lane index built by updateLanePositions
+    int leader = resolveVehicleHandle(store, store->leaders[id]);
+    // A vehicle in the middle of its turn has left the approach and finishes the turn
+    bool turning = state == STATE_TURNING;
+    bool hasLeader = !turning && leader >= 0 && store->direction[leader] == direction;
+    bool heldByLeader = false;
+
+    // Check the vehicle ahead in the same lane
+    if (hasLeader && !canSkipLight)
+    {
+        float distance = alongApproach(approach, store->x[leader], store->y[leader]) - along;
+        if (distance > 0 && distance < MIN_VEHICLE_DISTANCE)
         {
-        case TURN_LEFT:
-            turnPoint = INTERSECTION_Y - LANE_WIDTH - 40;
-            break;
-        case TURN_RIGHT:
-            turnPoint = INTERSECTION_Y + LANE_WIDTH + 40;
-            break;
+            shouldStop = true;
+            heldByLeader = true;
         }
     }
 
     // Check if vehicle should stop based on traffic lights
-    if (!shouldStop && !vehicle->canSkipLight)
+    if (!shouldStop && !canSkipLight && !turning)
     {
-        switch (vehicle->direction)
-        {
-        case DIRECTION_NORTH:
-            shouldStop = (vehicle->y > stopLine - stopDistance) &&
-                         (vehicle->y < stopLine) &&
-                         lights[DIRECTION_NORTH].state == RED;
-            break;
-        case DIRECTION_SOUTH:
-            shouldStop = (vehicle->y < stopLine + stopDistance) &&
-                         (vehicle->y > stopLine) &&
-                         lights[DIRECTION_SOUTH].state == RED;
-            break;
-        case DIRECTION_EAST:
-            shouldStop = (vehicle->x < stopLine + stopDistance) &&
-                         (vehicle->x > stopLine) &&
-                         lights[DIRECTION_EAST].state == RED;
-            break;
-        case DIRECTION_WEST:
-            shouldStop = (vehicle->x > stopLine - stopDistance) &&
-                         (vehicle->x < stopLine) &&
-                         lights[DIRECTION_WEST].state == RED;
-            break;
-        }
+        shouldStop = inStopWindow(approach, along) && lights[direction].state == RED;
     }
 
     // Update vehicle state based on stopping conditions
     if (shouldStop)
     {
-        vehicle->state = STATE_STOPPING;
-        vehicle->speed *= 0.8f; // Increased deceleration
-        if (vehicle->speed < 0.1f)
+        state = STATE_STOPPING;
+        speed *= 0.8f; // Increased deceleration
+        if (speed < 0.1f)
         {
-            vehicle->state = STATE_STOPPED;
-            vehicle->speed = 0;
+            state = STATE_STOPPED;
+            speed = 0;
         }
     }
 
-    else if (vehicle->state == STATE_STOPPED && !shouldStop)
+    else if (state == STATE_STOPPED && !shouldStop)
     {
-        vehicle->state = STATE_MOVING;
+        state = STATE_MOVING;
         // Reset speed based on vehicle type
-        switch (vehicle->type)
-        {
-        case AMBULANCE:
-        case POLICE_CAR:
-            vehicle->speed = 4.0f;
-            break;
-        case FIRE_TRUCK:
-            vehicle->speed = 3.5f;
-            break;
-        default:
-            vehicle->speed = 2.0f;
-        }
+        speed = sim->parameters.speeds[store->type[index]];
     }
 
     // Decrease speed as vehicle approaches turn point
-    if (vehicle->state == STATE_MOVING && vehicle->turnDirection != TURN_NONE)
+    if (state == STATE_MOVING && turnDirection != TURN_NONE)
     {
-        float distanceToTurnPoint = 0;
-        switch (vehicle->direction)
+        float distanceToTurnPoint = fabs(along - approach->turnPoints[turnDirection]);
+        if (distanceToTurnPoint < STOP_DISTANCE)
         {
-        case DIRECTION_NORTH:
-        case DIRECTION_SOUTH:
-            distanceToTurnPoint = fabs(vehicle->y - turnPoint);
-            break;
-        case DIRECTION_EAST:
-        case DIRECTION_WEST:
-            distanceToTurnPoint = fabs(vehicle->x - turnPoint);
-            break;
-        }
-
-        if (distanceToTurnPoint < stopDistance)
-        {
-            vehicle->speed *= 1.0f;
-            if (vehicle->speed < 0.5f)
+            speed *= 1.0f;
+            if (speed < 0.5f)
             {
-                vehicle->speed = 0.5f;
+                speed = 0.5f;
             }
         }
     }
 
     // Check if at turning point
-    bool atTurnPoint = false;
-    switch (vehicle->direction)
-    {
-    case DIRECTION_NORTH:
-        atTurnPoint = vehicle->y <= INTERSECTION_Y;
-        break;
-    case DIRECTION_SOUTH:
-        atTurnPoint = vehicle->y >= INTERSECTION_Y;
-        break;
-    case DIRECTION_EAST:
-        atTurnPoint = vehicle->x >= INTERSECTION_X;
-        break;
-    case DIRECTION_WEST:
-        atTurnPoint = vehicle->x <= INTERSECTION_X;
-        break;
-    }
+    bool atTurnPoint = along >= approach->turnStart;
 
     // Start turning if at turn point
-    if (atTurnPoint && vehicle->turnDirection != TURN_NONE &&
-        vehicle->state != STATE_TURNING && vehicle->state != STATE_STOPPED)
+    if (atTurnPoint && turnDirection != TURN_NONE &&
+        state != STATE_TURNING && state != STATE_STOPPED)
     {
-        vehicle->state = STATE_TURNING;
-        vehicle->turnAngle = 0.0f;
-        vehicle->turnProgress = 0.0f;
+        state = STATE_TURNING;
+        store->turnAngle[index] = 0.0f;
     }
 
     // Movement logic
-    float moveSpeed = vehicle->speed;
-    if (vehicle->state == STATE_MOVING || vehicle->state == STATE_STOPPING)
+    float moveSpeed = speed;
+    if (state == STATE_MOVING || state == STATE_STOPPING)
     {
-        switch (vehicle->direction)
-        {
-        case DIRECTION_NORTH:
-            vehicle->y -= moveSpeed;
-            break;
-        case DIRECTION_SOUTH:
-            vehicle->y += moveSpeed;
-            break;
-        case DIRECTION_EAST:
-            vehicle->x += moveSpeed;
-            break;
-        case DIRECTION_WEST:
-            vehicle->x -= moveSpeed;
-            break;
-        }
-    }
-    else if (vehicle->state == STATE_TURNING)
-    {
-        // Calculate turn angle based on vehicle type
-        float turnSpeed = 1.0f;
-
-        vehicle->turnAngle += turnSpeed;
-        vehicle->turnProgress = vehicle->turnAngle / 90.0f;
-        if (vehicle->turnAngle >= 90.0f)
-        {
-            vehicle->state = STATE_MOVING;
-            vehicle->turnAngle = 0.0f;
-            vehicle->turnProgress = 0.0f;
-            vehicle->isInRightLane = !vehicle->isInRightLane;
-        }
-
-        // Calculate new position based on turn angle
-        float turnRadius = 0.5f;
-        float turnCenterX = 0;
-        float turnCenterY = 0;
-        float turnCenter = 15;
-        switch (vehicle->direction)
+        x += approach->headingX * moveSpeed;
+        y += approach->headingY * moveSpeed;
+    }
+    else if (state == STATE_TURNING)
+    {
+        // Place the vehicle on the tabulated arc at its new progress
+        const TurnArc *arc = &turnArcs[direction][turnDirection == TURN_LEFT ? 0 : 1];
+        float next = store->turnAngle[index] + (speed > 0.5f ? speed : 0.5f) * arc->degreesPerPixel;
+        if (next > TURN_ARC_STEPS)
         {
-        case DIRECTION_NORTH:
-            turnCenterX = vehicle->x + (vehicle->isInRightLane ? turnCenter : -turnCenter);
-            turnCenterY = vehicle->y;
-            ;
-            break;
-        case DIRECTION_SOUTH:
-            turnCenterX = vehicle->x + (vehicle->isInRightLane ? -turnCenter : turnCenter);
-            turnCenterY = vehicle->y;
-            break;
-        case DIRECTION_EAST:
-            turnCenterX = vehicle->x;
-            turnCenterY = vehicle->y + (!vehicle->isInRightLane ? turnCenter : -turnCenter);
-            break;
-        case DIRECTION_WEST:
-            turnCenterX = vehicle->x;
-            turnCenterY = vehicle->y + (!vehicle->isInRightLane ? -turnCenter : turnCenter);
-            break;
-        }
-
-        float radians = vehicle->turnAngle * M_PI / 180.0f;
-        switch (vehicle->direction)
+            next = TURN_ARC_STEPS;
+        }
+        float dx, dy;
+        turnArcOffset(arc, next, &dx, &dy);
+        x = arc->startX + dx;
+        y = arc->startY + dy;
+        store->turnAngle[index] = next;
+
+        if (next >= TURN_ARC_STEPS)
         {
-        case DIRECTION_NORTH:
-            vehicle->x = turnCenterX + turnRadius * sin(radians);
-            vehicle->y = turnCenterY - turnRadius * cos(radians);
-            break;
-        case DIRECTION_SOUTH:
-            vehicle->x = turnCenterX - turnRadius * sin(radians);
-            vehicle->y = turnCenterY + turnRadius * cos(radians);
-            break;
-        case DIRECTION_EAST:
-            vehicle->x = turnCenterX + turnRadius * cos(radians);
-            vehicle->y = turnCenterY + turnRadius * sin(radians);
-            break;
-        case DIRECTION_WEST:
-            vehicle->x = turnCenterX - turnRadius * cos(radians);
-            vehicle->y = turnCenterY - turnRadius * sin(radians);
-            break;
-        }
-    }
-    // Update rectangle position
-    vehicle->rect.x = (int)vehicle->x;
-    vehicle->rect.y = (int)vehicle->y;
+            // Drive off along the exit road like any through vehicle
+            state = STATE_MOVING;
+            direction = arc->exitDirection;
+            store->direction[index] = direction;
+            store->turnDirection[index] = TURN_NONE;
+            store->turnAngle[index] = 0.0f;
+        }
+    }
+
+    // Vehicles sleeping behind this one may be free to move now
+    if (x != store->x[index] || y != store->y[index])
+    {
+        wakeSleepers(sim, &sim->sleepers[id]);
+    }
+    store->x[index] = x;
+    store->y[index] = y;
+    store->speed[index] = speed;
+    store->state[index] = state;
+    if (state == STATE_STOPPING || state == STATE_STOPPED)
+    {
+        store->waitMs[index] += sim->clock.tickMs;
+    }
+    // A stopped vehicle stays put until its leader moves or, if nothing but the
+    // light holds it, until the light changes. Emergency vehicles stay awake since
+    // the signal controller may wave them through at any tick.
+    if (state == STATE_STOPPED && store->type[index] == REGULAR_CAR)
+    {
+        parkVehicle(sim, id, heldByLeader ? store->ids[leader] : -1, direction);
+    }
 
     // Check if vehicle has left the screen
-    if (vehicle->x < -100 || vehicle->x > WINDOW_WIDTH + 100 ||
-        vehicle->y < -100 || vehicle->y > WINDOW_HEIGHT + 100)
+    if (x < -100 || x > WINDOW_WIDTH + 100 ||
+        y < -100 || y > WINDOW_HEIGHT + 100)
     {
-        vehicle->active = false;
+        addWaitSample(&sim->stats.waits, store->waitMs[index]);
+        wakeSleepers(sim, &sim->sleepers[id]);
+        releaseVehicleSlot(store, index);
+        return false;
     }
+    return true;
+}
 
-    // Update rectangle position
-    vehicle->rect.x = (int)vehicle->x;
-    vehicle->rect.y = (int)vehicle->y;
+// Returns the distance along the lane, smaller values being further ahead
+static float getLanePosition(VehicleStore *store, int index)
+{
+    return -alongApproach(&APPROACHES[store->direction[index]], store->x[index], store->y[index]);
+}
 
-    // Check if vehicle has left the screen
-    if (vehicle->x < -100 || vehicle->x > WINDOW_WIDTH + 100 ||
-        vehicle->y < -100 || vehicle->y > WINDOW_HEIGHT + 100)
+// Ends the platoon being built. A vehicle following too closely behind the tail
+// would react to when the tail moves, so the tail is left out.
+static void closePlatoon(Simulation *sim, int *memberCount, bool followerClear)
+{
+    Platoon *platoon = &sim->platoons[sim->platoonCount - 1];
+    if (!followerClear)
     {
-        vehicle->active = false;
+        platoon->count--;
+        *memberCount -= 1;
+    }
+    if (platoon->count == 0)
+    {
+        sim->platoonCount--;
     }
 }
 
-void updateLanePositions(Vehicle *vehicles)
+// Splits every lane into platoons of vehicles that are moving, braking ones
+// included. The head must be at least MIN_VEHICLE_DISTANCE behind its own
+// leader too, so no member is held up this tick, whenever the vehicle ahead of
+// it moves.
+static void buildPlatoons(Simulation *sim)
 {
-    // Reset lane tracking
+    VehicleStore *store = &sim->vehicles;
+    int memberCount = 0;
+    sim->platoonCount = 0;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        // Lanes 0 and 1 carry North/South traffic, lanes 2 and 3 East/West
+        for (int pass = 0; pass < 2; pass++)
+        {
+            Direction direction = (Direction)((lane < 2 ? DIRECTION_NORTH : DIRECTION_EAST) + pass);
+            const LanePosition *entries = sim->laneVehicles[lane];
+            bool building = false;
+            bool hasLeader = false;
+            float leaderPosition = 0;
+            for (int i = 0; i < sim->vehiclesInLane[lane]; i++)
+            {
+                if (entries[i].direction != direction)
+                {
+                    continue;
+                }
+                int index = resolveVehicleHandle(store, entries[i].vehicle);
+                bool clear = !hasLeader || entries[i].position - leaderPosition >= MIN_VEHICLE_DISTANCE;
+                bool moving = store->state[index] == STATE_MOVING || store->state[index] == STATE_STOPPING;
+                if (building && !(clear && moving))
+                {
+                    closePlatoon(sim, &memberCount, clear);
+                    building = false;
+                }
+                if (!building && clear && moving)
+                {
+                    sim->platoons[sim->platoonCount++] = (Platoon){
+                        .direction = direction,
+                        .first = memberCount,
+                        .count = 0};
+                    building = true;
+                }
+                if (building)
+                {
+                    sim->platoonMembers[memberCount++] = entries[i].vehicle;
+                    sim->platoons[sim->platoonCount - 1].count++;
+                }
+                hasLeader = true;
+                leaderPosition = entries[i].position;
+            }
+            if (building)
+            {
+                closePlatoon(sim, &memberCount, true);
+            }
+        }
+    }
+}
+
+void updateLanePositions(Simulation *sim)
+{
+    VehicleStore *store = &sim->vehicles;
+    LanePosition **laneVehicles = sim->laneVehicles;
+    int *vehiclesInLane = sim->vehiclesInLane;
+    if (sim->laneBufferCapacity < store->capacity)
+    {
+        sim->laneBuffer = (LanePosition *)realloc(sim->laneBuffer, store->capacity * sizeof(LanePosition));
+        sim->platoons = (Platoon *)realloc(sim->platoons, store->capacity * sizeof(Platoon));
+        sim->platoonMembers = (VehicleHandle *)realloc(sim->platoonMembers, store->capacity * sizeof(VehicleHandle));
+        sim->platooned = (bool *)realloc(sim->platooned, store->capacity * sizeof(bool));
+        for (int id = sim->laneBufferCapacity; id < store->capacity; id++)
+        {
+            sim->platooned[id] = false;
+        }
+        sim->laneBufferCapacity = store->capacity;
+    }
+    if (sim->sleepCapacity < store->capacity)
+    {
+        growSleepLists(sim, store->capacity);
+    }
+
+    // Count vehicles per lane, then carve the shared buffer into one run per lane
+    int lanes[4] = {0};
+    for (int i = 0; i < store->count; i++)
+    {
+        lanes[getVehicleLane(store, i)]++;
+    }
+    int offset = 0;
     for (int i = 0; i < 4; i++)
     {
+        laneVehicles[i] = sim->laneBuffer + offset;
+        offset += lanes[i];
         vehiclesInLane[i] = 0;
     }
 
     // Update lane positions for active vehicles
-    for (int i = 0; i < MAX_VEHICLES; i++)
+    for (int i = 0; i < store->count; i++)
     {
-        if (vehicles[i].active)
-        {
-            int lane = getVehicleLane(&vehicles[i]);
-            float pos;
+        int lane = getVehicleLane(store, i);
+        LanePosition *entry = &laneVehicles[lane][vehiclesInLane[lane]++];
+        entry->position = getLanePosition(store, i);
+        entry->direction = store->direction[i];
+        entry->vehicle = getVehicleHandle(store, i);
+    }
 
-            // Calculate position along the lane
-            switch (vehicles[i].direction)
-            {
-            case DIRECTION_NORTH:
-                pos = vehicles[i].y;
-                break;
-            case DIRECTION_SOUTH:
-                pos = -vehicles[i].y;
-                break;
-            case DIRECTION_EAST:
-                pos = -vehicles[i].x;
-                break;
-            case DIRECTION_WEST:
-                pos = vehicles[i].x;
-                break;
-            }
+    // Order each lane front to back so every vehicle's leader is its predecessor
+    for (int i = 0; i < 4; i++)
+    {
+        sortLanePositions(laneVehicles[i], vehiclesInLane[i]);
+        findLaneLeaders(laneVehicles[i], vehiclesInLane[i], store->leaders);
+    }
+    buildPlatoons(sim);
+}
+
+static int compareLanePositions(const void *a, const void *b)
+{
+    const LanePosition *first = (const LanePosition *)a;
+    const LanePosition *second = (const LanePosition *)b;
+    if (first->position != second->position)
+    {
+        return (first->position < second->position) ? -1 : 1;
+    }
+    // Break ties by vehicle id so the order does not depend on the sort implementation
+    return first->vehicle.id - second->vehicle.id;
+}
+
+// Sorts lane entries by ascending position, i.e. from the front of the lane backwards
+void sortLanePositions(LanePosition *entries, int count)
+{
+    qsort(entries, count, sizeof(LanePosition), compareLanePositions);
+}
+
+// For a sorted lane, records for every vehicle the nearest vehicle strictly ahead of it
+// travelling in the same direction, or a handle with id -1. leaders is indexed by vehicle id.
+void findLaneLeaders(const LanePosition *entries, int count, VehicleHandle *leaders)
+{
+    const VehicleHandle none = {-1, 0};
+    VehicleHandle last[4] = {none, none, none, none};
+    VehicleHandle lastLeader[4] = {none, none, none, none};
+    float lastPosition[4] = {0};
 
-            laneVehicles[lane][vehiclesInLane[lane]].position = pos;
-            laneVehicles[lane][vehiclesInLane[lane]].vehicle = &vehicles[i];
-            vehiclesInLane[lane]++;
+    for (int i = 0; i < count; i++)
+    {
+        VehicleHandle vehicle = entries[i].vehicle;
+        Direction direction = entries[i].direction;
+        VehicleHandle leader = last[direction];
+        if (last[direction].id >= 0 && lastPosition[direction] == entries[i].position)
+        {
+            // Level with the previous vehicle, so it shares that vehicle's leader
+            leader = lastLeader[direction];
         }
+        leaders[vehicle.id] = leader;
+        lastLeader[direction] = leader;
+        last[direction] = vehicle;
+        lastPosition[direction] = entries[i].position;
     }
 }
 
@@ -756,26 +1491,27 @@ void renderRoads(SDL_Renderer *renderer)
     SDL_RenderFillRect(renderer, &westStop);
 }
 
-void renderQueues(SDL_Renderer *renderer)
+void renderQueues(SDL_Renderer *renderer, Simulation *sim)
 {
     for (int i = 0; i < 4; i++)
     {
         int x = 10 + i * 200; // Adjust position for each lane
         int y = 10;
-        Node *current = laneQueues[i].front;
-        while (current != NULL)
+        for (int j = 0; j < queueSize(&sim->laneQueues[i]); j++)
         {
             SDL_Rect vehicleRect = {x, y, 30, 30};
             SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255); // Blue color for vehicles
             SDL_RenderFillRect(renderer, &vehicleRect);
             y += 40; // Move down for the next vehicle
-            current = current->next;
         }
     }
 }
 
-void renderSimulation(SDL_Renderer *renderer, Vehicle *vehicles, TrafficLight *lights, Statistics *stats)
+void renderSimulation(SDL_Renderer *renderer, Simulation *sim)
 {
+    VehicleStore *store = &sim->vehicles;
+    TrafficLight *lights = sim->lights;
+
     SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255); // Brighter background color
     SDL_RenderClear(renderer);
 
@@ -792,17 +1528,16 @@ void renderSimulation(SDL_Renderer *renderer, Vehicle *vehicles, TrafficLight *l
     }
 
     // Render vehicles
-    for (int i = 0; i < MAX_VEHICLES; i++)
+    for (int i = 0; i < store->count; i++)
     {
-        if (vehicles[i].active)
-        {
-            SDL_SetRenderDrawColor(renderer, VEHICLE_COLORS[vehicles[i].type].r, VEHICLE_COLORS[vehicles[i].type].g, VEHICLE_COLORS[vehicles[i].type].b, VEHICLE_COLORS[vehicles[i].type].a);
-            SDL_RenderFillRect(renderer, &vehicles[i].rect);
-        }
+        SDL_Color color = VEHICLE_COLORS[store->type[i]];
+        SDL_Rect rect = getVehicleRect(store, i);
+        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+        SDL_RenderFillRect(renderer, &rect);
     }
 
     // Render queues
-    renderQueues(renderer);
+    renderQueues(renderer, sim);
 
     SDL_RenderPresent(renderer);
 }
@@ -810,47 +1545,118 @@ void renderSimulation(SDL_Renderer *renderer, Vehicle *vehicles, TrafficLight *l
 // Queue functions
 void initQueue(Queue *q)
 {
-    q->front = q->rear = NULL;
+    q->items = NULL;
+    q->capacity = 0;
+    q->head = 0;
     q->size = 0;
+    q->highWaterMark = 0;
 }
 
-void enqueue(Queue *q, Vehicle vehicle)
+// Moves the ring into a new buffer and unwraps it so the front element lands at index 0.
+// Returns false, leaving the queue unchanged, if the buffer cannot be allocated.
+static bool resizeQueue(Queue *q, int newCapacity)
 {
-    Node *newNode = (Node *)malloc(sizeof(Node));
-    newNode->vehicle = vehicle;
-    newNode->next = NULL;
-    if (q->rear == NULL)
+    Vehicle *items = (Vehicle *)malloc((size_t)newCapacity * sizeof(Vehicle));
+    if (items == NULL)
     {
-        q->front = q->rear = newNode;
+        return false;
     }
-    else
+    if (q->size > 0)
+    {
+        int firstPart = q->capacity - q->head;
+        if (firstPart > q->size)
+        {
+            firstPart = q->size;
+        }
+        memcpy(items, q->items + q->head, firstPart * sizeof(Vehicle));
+        memcpy(items + firstPart, q->items, (q->size - firstPart) * sizeof(Vehicle));
+    }
+    free(q->items);
+    q->items = items;
+    q->capacity = newCapacity;
+    q->head = 0;
+    return true;
+}
+
+// Preallocates room for at least capacity vehicles, rounded up to a power of two.
+// Returns false if that is more than QUEUE_MAX_CAPACITY or cannot be allocated.
+bool reserveQueue(Queue *q, int capacity)
+{
+    if (capacity > QUEUE_MAX_CAPACITY)
+    {
+        return false;
+    }
+    int newCapacity = QUEUE_INITIAL_CAPACITY;
+    while (newCapacity < capacity)
+    {
+        newCapacity *= 2;
+    }
+    return newCapacity <= q->capacity || resizeQueue(q, newCapacity);
+}
+
+// Drops the vehicle if the queue is full and cannot grow
+void enqueue(Queue *q, Vehicle vehicle)
+{
+    if (q->size == q->capacity &&
+        (q->capacity == QUEUE_MAX_CAPACITY ||
+         !resizeQueue(q, (q->capacity == 0) ? QUEUE_INITIAL_CAPACITY : q->capacity * 2)))
     {
-        q->rear->next = newNode;
-        q->rear = newNode;
+        return;
     }
+    q->items[(q->head + q->size) & (q->capacity - 1)] = vehicle;
     q->size++;
+    if (q->size > q->highWaterMark)
+    {
+        q->highWaterMark = q->size;
+    }
 }
 
 Vehicle dequeue(Queue *q)
 {
-    if (q->front == NULL)
+    if (q->size == 0)
     {
         Vehicle emptyVehicle = {0};
         return emptyVehicle;
     }
-    Node *temp = q->front;
-    Vehicle vehicle = temp->vehicle;
-    q->front = q->front->next;
-    if (q->front == NULL)
-    {
-        q->rear = NULL;
-    }
-    free(temp);
+    Vehicle vehicle = q->items[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
     q->size--;
     return vehicle;
 }
 
 int isQueueEmpty(Queue *q)
 {
-    return q->front == NULL;
-}
\ No newline at end of file
+    return q->size == 0;
+}
+
+Vehicle *peekQueue(Queue *q)
+{
+    return (q->size == 0) ? NULL : &q->items[q->head];
+}
+
+int queueSize(Queue *q)
+{
+    return q->size;
+}
+
+// Random access from the front of the queue (index 0 is the next to dequeue)
+Vehicle *queueAt(Queue *q, int index)
+{
+    if (index < 0 || index >= q->size)
+    {
+        return NULL;
+    }
+    return &q->items[(q->head + index) & (q->capacity - 1)];
+}
+
+// Largest number of vehicles the queue has held at once
+int queueHighWaterMark(Queue *q)
+{
+    return q->highWaterMark;
+}
+
+void freeQueue(Queue *q)
+{
+    free(q->items);
+    initQueue(q);
+}
@@ -3,11 +3,15 @@
 
 #include <SDL.h>
 #include <stdbool.h>
+#include "random_stream.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 #define LANE_WIDTH 80
-#define MAX_VEHICLES 100
+// Default limit on simultaneously active vehicles; overridable at runtime
+#define DEFAULT_MAX_VEHICLES 100
+// Vehicle storage starts at this many slots and doubles up to the limit
+#define VEHICLE_STORE_INITIAL_CAPACITY 128
 #define INTERSECTION_X (WINDOW_WIDTH / 2)
 #define INTERSECTION_Y (WINDOW_HEIGHT / 2)
 
@@ -15,6 +19,31 @@
 #define TRAFFIC_LIGHT_HEIGHT (LANE_WIDTH - LANE_WIDTH / 3)
 #define STOP_LINE_WIDTH 5
 
+// Vehicle footprint; length is measured along the direction of travel
+#define VEHICLE_LENGTH 30
+#define VEHICLE_WIDTH 20
+// A vehicle stops when the one ahead is closer than this
+#define MIN_VEHICLE_DISTANCE 40.0f
+// Length of the stretch before a red light, or a turn point, in which vehicles react to it
+#define STOP_DISTANCE 40.0f
+// Turn arcs are tabulated at one sample per degree of turnAngle
+#define TURN_ARC_STEPS 90
+
+// Fixed simulation step; one tick is one frame at ~60 FPS
+#define SIMULATION_TICK_MS 16
+
+// Defaults of the tunable SimulationParameters
+#define DEFAULT_SIGNAL_CYCLE_MS 5000       // Green time of each phase in the normal cycle
+#define DEFAULT_PRIORITY_WINDOW_MS 10000   // Time a priority phase is held before it is reviewed
+#define DEFAULT_CONGESTION_THRESHOLD 5     // Priority goes to a lane with more vehicles than this
+
+// Wait-time distribution: one bin per second below WAIT_HISTOGRAM_LINEAR_BINS
+// seconds, then WAIT_HISTOGRAM_SUB_BINS bins per doubling, so every Uint32 wait
+// has a bin no wider than about 3% of its value
+#define WAIT_HISTOGRAM_LINEAR_BINS 64
+#define WAIT_HISTOGRAM_SUB_BINS 32
+#define WAIT_HISTOGRAM_BINS (WAIT_HISTOGRAM_LINEAR_BINS + 17 * WAIT_HISTOGRAM_SUB_BINS) // Up to 2^23 s
+
 typedef enum {
     DIRECTION_NORTH,
     DIRECTION_SOUTH,
@@ -63,6 +92,59 @@ typedef struct {
     bool canSkipLight; 
 } Vehicle;
 
+// Fixed-size description of a vehicle entering the simulation, as exchanged
+// between the generator and the simulator
+typedef struct {
+    Uint32 timestamp;    // Simulated milliseconds at which the vehicle enters
+    Uint8 direction;     // Direction
+    Uint8 type;          // VehicleType
+    Uint8 turnDirection; // TurnDirection
+    Uint8 lane;          // 0 = through lane, 1 = right-turn lane
+} SpawnRecord;
+
+// Stable reference to a vehicle. The id never changes while the vehicle is alive;
+// the generation is bumped when the id is recycled so stale handles can be detected.
+typedef struct {
+    int id;
+    Uint32 generation;
+} VehicleHandle;
+
+// Structure-of-arrays vehicle storage used by the update loop. Each field lives in
+// its own contiguous array so per-tick kinematics stream through cache lines
+// instead of striding over fields they do not touch. The arrays are dense: indices
+// [0, count) are exactly the active vehicles, and removal swaps the last vehicle
+// into the hole, so every pass costs O(active) rather than O(capacity).
+typedef struct {
+    int count;
+    int capacity;    // Slots currently allocated
+    int maxVehicles; // Storage grows on demand up to this many vehicles
+
+    // Hot: read or written by every vehicle update
+    float* x;
+    float* y;
+    float* speed;
+    VehicleState* state;
+    Direction* direction;
+    VehicleType* type;
+    int* ids;
+
+    // Cold: only needed for turning, light skipping and rendering
+    TurnDirection* turnDirection;
+    float* turnAngle;
+    bool* isInRightLane;
+    bool* canSkipLight;
+    Uint32* waitMs; // Time spent braking for or standing at a stop
+
+    // Indexed by vehicle id rather than dense index
+    int* denseIndex;
+    Uint32* generations;
+    VehicleHandle* leaders; // Nearest vehicle ahead in the same lane and direction
+
+    // Stack of unused ids used for O(1) spawning
+    int* freeIds;
+    int freeCount;
+} VehicleStore;
+
 typedef struct {
     TrafficLightState state;
     int timer;
@@ -70,49 +152,180 @@ typedef struct {
     Direction direction;
 } TrafficLight;
 
+// Tunable constants of the signal controller and the vehicles. initSimulation
+// sets the defaults; callers such as parameter sweeps override them before running.
+typedef struct {
+    Uint32 cycleMs;
+    Uint32 priorityWindowMs;
+    int congestionThreshold;
+    float speeds[4]; // Cruising speed in pixels per tick, indexed by VehicleType
+} SimulationParameters;
+
+// Signal controller state carried from one tick to the next
+typedef struct {
+    Uint32 lastStateChangeTicks;
+    int currentPhase; // 0 = North/South green, 1 = East/West green
+    bool priorityMode;
+    int priorityLane;
+    Uint32 priorityStartTime;
+} SignalController;
+
+// How long vehicles that left the intersection spent waiting on the way through
+typedef struct {
+    Uint64 counts[WAIT_HISTOGRAM_BINS];
+    Uint64 samples;
+    Uint64 totalMs;
+    Uint32 maxMs;
+} WaitHistogram;
+
 typedef struct {
     int vehiclesPassed;
     int totalVehicles;
     float vehiclesPerMinute;
     Uint32 startTime;
+    WaitHistogram waits;
 } Statistics;
 
-// Queue data structure
-typedef struct Node {
-    Vehicle vehicle;
-    struct Node* next;
-} Node;
+// Deterministic simulation clock, advanced by a fixed step every tick
+typedef struct {
+    Uint32 tickMs;
+    Uint32 now;
+    Uint32 ticks;
+} SimulationClock;
+
+// Accumulated time spent in each stage of simulationStep, in performance counter units
+typedef struct {
+    Uint64 laneIndex;
+    Uint64 signals;
+    Uint64 vehicles;
+    Uint64 statistics;
+} StageTimings;
+
+// Queue data structure: growable ring buffer, capacity is always a power of two
+#define QUEUE_INITIAL_CAPACITY 16
+// Lane queues are presized so steady-state traffic never reallocates them
+#define LANE_QUEUE_CAPACITY 128
+// Largest power of two an int capacity can double to
+#define QUEUE_MAX_CAPACITY (1 << 30)
 
 typedef struct {
-    Node* front;
-    Node* rear;
+    Vehicle* items;
+    int capacity;
+    int head;
     int size;
+    int highWaterMark;
 } Queue;
 
 typedef struct {
     float position;
-    Vehicle* vehicle;
+    Direction direction;
+    VehicleHandle vehicle;
 } LanePosition;
 
-// Declare laneQueues as an external variable
-extern Queue laneQueues[4];
+// A run of moving vehicles travelling one behind the other in a lane, each at
+// least MIN_VEHICLE_DISTANCE behind the one ahead, so none holds up another.
+// Platoons are rebuilt with the lane index and moved as a unit while they cruise on.
+typedef struct {
+    Direction direction;
+    int first; // Head's slot in Simulation.platoonMembers; the others follow front to back
+    int count;
+} Platoon;
+
+// One complete intersection. Every piece of state a run depends on lives here
+// rather than in globals, so independent simulations can run side by side,
+// each on its own thread.
+typedef struct {
+    SimulationParameters parameters;
+    VehicleStore vehicles;
+    TrafficLight lights[4];
+    SignalController controller;
+    Statistics stats;
+    SimulationClock clock;
+    Queue laneQueues[4];
+    int lanePriorities[4];
+
+    // Per-lane views into the lane index, rebuilt by updateLanePositions
+    LanePosition* laneVehicles[4];
+    int vehiclesInLane[4];
+    // All four lanes share one buffer, partitioned by lane on every rebuild
+    LanePosition* laneBuffer;
+    int laneBufferCapacity;
+    // Platoons found in the lane index, sized like the lane buffer
+    Platoon* platoons;
+    int platoonCount;
+    VehicleHandle* platoonMembers;
+    bool* platooned; // Indexed by vehicle id: already moved with its platoon this tick
+
+    // Stopped vehicles that cannot move until their leader moves or their light
+    // changes sleep through their updates. Each sleeping vehicle is parked on
+    // exactly one wait list: that of the leader holding it, or that of its
+    // approach when it waits at a red light. Indexed by vehicle id.
+    bool* asleep;
+    int* sleepingBehind;   // Leader holding the vehicle, or -1 when it waits for the light
+    int* sleepers;         // First vehicle sleeping behind this one, or -1
+    int* nextSleeper;      // Neighbours on the same wait list, or -1
+    int* previousSleeper;
+    int sleepCapacity;
+    int lightSleepers[4];  // Vehicles waiting at each approach's red light, or -1
+
+    bool quiet; // Suppresses the signal change log, e.g. for batch runs
+    // Set by simulationStep when the tick changed nothing but the clock and wait times,
+    // so the following ticks repeat it until a timer or an arrival intervenes
+    bool idle;
+} Simulation;
 
 // Function declarations
-void initializeTrafficLights(TrafficLight* lights);
-void updateTrafficLights(TrafficLight* lights);
-Vehicle* createVehicle(Direction direction);
-void updateVehicle(Vehicle* vehicle, TrafficLight* lights);
-void renderSimulation(SDL_Renderer* renderer, Vehicle* vehicles, TrafficLight* lights, Statistics* stats);
+void defaultSimulationParameters(SimulationParameters* parameters);
+void initSimulation(Simulation* sim, int maxVehicles, Uint32 tickMs);
+void freeSimulation(Simulation* sim);
+void simulationStep(Simulation* sim, StageTimings* timings);
+Uint32 nextSignalEvent(const Simulation* sim);
+Uint32 skipIdleTicks(Simulation* sim, Uint32 nextEvent);
+void wakeAllVehicles(Simulation* sim);
+void initSimulationClock(SimulationClock* clock, Uint32 tickMs);
+void advanceSimulationClock(SimulationClock* clock);
+void initializeTrafficLights(Simulation* sim);
+void updateTrafficLights(Simulation* sim);
+Vehicle* createVehicle(Direction direction, RandomStream* random);
+void initVehicle(Vehicle* vehicle, Direction direction, RandomStream* random);
+void setupVehicle(Vehicle* vehicle, Direction direction, VehicleType type, TurnDirection turnDirection);
+void makeSpawnRecord(SpawnRecord* record, const Vehicle* vehicle, Uint32 timestamp);
+bool updateVehicle(Simulation* sim, int index);
+void renderSimulation(SDL_Renderer* renderer, Simulation* sim);
 void renderRoads(SDL_Renderer* renderer);
-void renderQueues(SDL_Renderer* renderer);
-float getDistanceBetweenVehicles(Vehicle* v1, Vehicle* v2);
-int getVehicleLane(Vehicle* vehicle);
-void updateLanePositions(Vehicle* vehicles);
+void renderQueues(SDL_Renderer* renderer, Simulation* sim);
+void addWaitSample(WaitHistogram* histogram, Uint32 waitMs);
+void mergeWaitHistograms(WaitHistogram* into, const WaitHistogram* from);
+double waitPercentile(const WaitHistogram* histogram, double fraction);
+double meanWait(const WaitHistogram* histogram);
+float getDistanceBetweenVehicles(VehicleStore* store, int a, int b);
+int getVehicleLane(VehicleStore* store, int index);
+void updateLanePositions(Simulation* sim);
+void sortLanePositions(LanePosition* entries, int count);
+void findLaneLeaders(const LanePosition* entries, int count, VehicleHandle* leaders);
+
+// Vehicle store functions
+void initVehicleStore(VehicleStore* store, int maxVehicles);
+void freeVehicleStore(VehicleStore* store);
+void storeVehicle(VehicleStore* store, int index, const Vehicle* vehicle);
+int allocateVehicleSlot(VehicleStore* store);
+void releaseVehicleSlot(VehicleStore* store, int index);
+int spawnVehicle(VehicleStore* store, Direction direction, RandomStream* random);
+int spawnVehicleFromRecord(Simulation* sim, const SpawnRecord* record);
+VehicleHandle getVehicleHandle(VehicleStore* store, int index);
+int resolveVehicleHandle(VehicleStore* store, VehicleHandle handle);
+SDL_Rect getVehicleRect(VehicleStore* store, int index);
 
 // Queue functions
 void initQueue(Queue* q);
+bool reserveQueue(Queue* q, int capacity);
 void enqueue(Queue* q, Vehicle vehicle);
 Vehicle dequeue(Queue* q);
 int isQueueEmpty(Queue* q);
+Vehicle* peekQueue(Queue* q);
+int queueSize(Queue* q);
+Vehicle* queueAt(Queue* q, int index);
+int queueHighWaterMark(Queue* q);
+void freeQueue(Queue* q);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include "vehicle_channel.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static VehicleChannelShared *mapSharedSegment(VehicleChannel *channel, const char *name, bool create)
+{
+    HANDLE mapping = create
+                         ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(VehicleChannelShared), name)
+                         : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (mapping == NULL)
+    {
+        return NULL;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(VehicleChannelShared));
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        return NULL;
+    }
+    channel->mapping = mapping;
+    return (VehicleChannelShared *)view;
+}
+
+static void unmapSharedSegment(VehicleChannel *channel)
+{
+    UnmapViewOfFile(channel->shared);
+    CloseHandle((HANDLE)channel->mapping);
+}
+#else
+static VehicleChannelShared *mapSharedSegment(VehicleChannel *channel, const char *name, bool create)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, create ? (O_CREAT | O_RDWR) : O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (create && ftruncate(fd, sizeof(VehicleChannelShared)) != 0)
+    {
+        close(fd);
+        shm_unlink(path);
+        return NULL;
+    }
+    void *view = mmap(NULL, sizeof(VehicleChannelShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return NULL;
+    }
+    channel->mapping = NULL;
+    return (VehicleChannelShared *)view;
+}
+
+static void unmapSharedSegment(VehicleChannel *channel)
+{
+    munmap(channel->shared, sizeof(VehicleChannelShared));
+    if (channel->owner)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/%s", channel->name);
+        shm_unlink(path);
+    }
+}
+#endif
+
+// Creates the segment and resets the ring; called by the generator
+bool createVehicleChannel(VehicleChannel *channel, const char *name)
+{
+    memset(channel, 0, sizeof(VehicleChannel));
+    snprintf(channel->name, sizeof(channel->name), "%s", name);
+    channel->shared = mapSharedSegment(channel, name, true);
+    if (channel->shared == NULL)
+    {
+        return false;
+    }
+    channel->owner = true;
+    channel->shared->capacity = VEHICLE_CHANNEL_CAPACITY;
+    SDL_AtomicSet(&channel->shared->head, 0);
+    SDL_AtomicSet(&channel->shared->tail, 0);
+    // Publish the magic last so a reader never sees a half-initialised ring
+    SDL_MemoryBarrierRelease();
+    channel->shared->magic = VEHICLE_CHANNEL_MAGIC;
+    return true;
+}
+
+// Attaches to a segment created by the generator; called by the simulator
+bool openVehicleChannel(VehicleChannel *channel, const char *name)
+{
+    memset(channel, 0, sizeof(VehicleChannel));
+    snprintf(channel->name, sizeof(channel->name), "%s", name);
+    channel->shared = mapSharedSegment(channel, name, false);
+    if (channel->shared == NULL)
+    {
+        return false;
+    }
+    SDL_MemoryBarrierAcquire();
+    if (channel->shared->magic != VEHICLE_CHANNEL_MAGIC || channel->shared->capacity != VEHICLE_CHANNEL_CAPACITY)
+    {
+        closeVehicleChannel(channel);
+        return false;
+    }
+    // Start from whatever the previous reader left unread
+    channel->localIndex = (Uint32)SDL_AtomicGet(&channel->shared->tail);
+    channel->cachedPeerIndex = channel->localIndex;
+    return true;
+}
+
+void closeVehicleChannel(VehicleChannel *channel)
+{
+    if (channel->shared != NULL)
+    {
+        unmapSharedSegment(channel);
+    }
+    memset(channel, 0, sizeof(VehicleChannel));
+}
+
+// Appends up to count records and publishes them with a single store.
+// Returns how many fit; the rest should be retried once the simulator catches up.
+int writeVehicleChannel(VehicleChannel *channel, const SpawnRecord *records, int count)
+{
+    VehicleChannelShared *shared = channel->shared;
+    Uint32 head = channel->localIndex;
+    Uint32 space = VEHICLE_CHANNEL_CAPACITY - (head - channel->cachedPeerIndex);
+    if (space < (Uint32)count)
+    {
+        channel->cachedPeerIndex = (Uint32)SDL_AtomicGet(&shared->tail);
+        space = VEHICLE_CHANNEL_CAPACITY - (head - channel->cachedPeerIndex);
+    }
+    int written = ((Uint32)count < space) ? count : (int)space;
+
+    for (int i = 0; i < written; i++)
+    {
+        shared->records[(head + i) & (VEHICLE_CHANNEL_CAPACITY - 1)] = records[i];
+    }
+    if (written > 0)
+    {
+        channel->localIndex = head + written;
+        SDL_AtomicSet(&shared->head, (int)channel->localIndex);
+    }
+    return written;
+}
+
+// Points records at the unread records in the shared ring and returns how many
+// can be read contiguously. The records stay valid until they are consumed.
+int peekVehicleChannel(VehicleChannel *channel, const SpawnRecord **records)
+{
+    VehicleChannelShared *shared = channel->shared;
+    Uint32 tail = channel->localIndex;
+    if (channel->cachedPeerIndex == tail)
+    {
+        channel->cachedPeerIndex = (Uint32)SDL_AtomicGet(&shared->head);
+    }
+    Uint32 available = channel->cachedPeerIndex - tail;
+    Uint32 index = tail & (VEHICLE_CHANNEL_CAPACITY - 1);
+    Uint32 contiguous = VEHICLE_CHANNEL_CAPACITY - index;
+
+    *records = &shared->records[index];
+    return (int)((available < contiguous) ? available : contiguous);
+}
+
+// Hands count records back to the generator
+void consumeVehicleChannel(VehicleChannel *channel, int count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    channel->localIndex += count;
+    SDL_AtomicSet(&channel->shared->tail, (int)channel->localIndex);
+}
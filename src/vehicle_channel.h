@@ -0,0 +1,48 @@
+#ifndef VEHICLE_CHANNEL_H
+#define VEHICLE_CHANNEL_H
+
+#include "traffic_simulation.h"
+
+// Single-producer/single-consumer ring of SpawnRecords in a named shared-memory
+// segment. The generator writes records, the simulator reads them in place.
+#define VEHICLE_CHANNEL_NAME "traffic_vehicles"
+#define VEHICLE_CHANNEL_CAPACITY (1 << 16) // Records; must be a power of two
+#define VEHICLE_CHANNEL_MAGIC 0x43465254   // "TRFC"
+#define CACHE_LINE_SIZE 64
+
+// Layout of the shared segment. head and tail live on their own cache lines so
+// the two processes do not false-share.
+typedef struct {
+    Uint32 magic;
+    Uint32 capacity;
+    char headerPadding[CACHE_LINE_SIZE - 2 * sizeof(Uint32)];
+    SDL_atomic_t head; // Next record the generator writes; only the generator stores it
+    char headPadding[CACHE_LINE_SIZE - sizeof(SDL_atomic_t)];
+    SDL_atomic_t tail; // Next record the simulator reads; only the simulator stores it
+    char tailPadding[CACHE_LINE_SIZE - sizeof(SDL_atomic_t)];
+    SpawnRecord records[VEHICLE_CHANNEL_CAPACITY];
+} VehicleChannelShared;
+
+typedef struct {
+    VehicleChannelShared* shared;
+    void* mapping; // Platform handle of the shared-memory object
+    bool owner;
+    char name[64];
+    // Each side keeps its own index privately and caches the other side's,
+    // so the shared atomics are only touched once per batch
+    Uint32 localIndex;
+    Uint32 cachedPeerIndex;
+} VehicleChannel;
+
+bool createVehicleChannel(VehicleChannel* channel, const char* name);
+bool openVehicleChannel(VehicleChannel* channel, const char* name);
+void closeVehicleChannel(VehicleChannel* channel);
+
+// Producer side
+int writeVehicleChannel(VehicleChannel* channel, const SpawnRecord* records, int count);
+
+// Consumer side
+int peekVehicleChannel(VehicleChannel* channel, const SpawnRecord** records);
+void consumeVehicleChannel(VehicleChannel* channel, int count);
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vehicle_trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool openTraceWriter(TraceWriter *writer, const char *path)
+{
+    writer->file = fopen(path, "wb");
+    writer->buffer = (char *)malloc(TRACE_WRITE_BUFFER_SIZE);
+    if (writer->file == NULL || writer->buffer == NULL)
+    {
+        closeTraceWriter(writer);
+        return false;
+    }
+    // The writer does its own buffering; stdio would only add a second copy
+    setvbuf(writer->file, NULL, _IONBF, 0);
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(SpawnRecord);
+    memcpy(writer->buffer, &header, sizeof(header));
+    writer->used = sizeof(header);
+    return true;
+}
+
+bool writeTraceRecords(TraceWriter *writer, const SpawnRecord *records, size_t count)
+{
+    const char *bytes = (const char *)records;
+    size_t remaining = count * sizeof(SpawnRecord);
+    while (remaining > 0)
+    {
+        size_t chunk = TRACE_WRITE_BUFFER_SIZE - writer->used;
+        if (chunk > remaining)
+        {
+            chunk = remaining;
+        }
+        memcpy(writer->buffer + writer->used, bytes, chunk);
+        writer->used += chunk;
+        bytes += chunk;
+        remaining -= chunk;
+
+        if (writer->used == TRACE_WRITE_BUFFER_SIZE && !flushTraceWriter(writer))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hands everything buffered so far to the OS, making it visible to readers
+bool flushTraceWriter(TraceWriter *writer)
+{
+    if (writer->used == 0)
+    {
+        return true;
+    }
+    bool ok = fwrite(writer->buffer, 1, writer->used, writer->file) == writer->used;
+    writer->used = 0;
+    return ok;
+}
+
+void closeTraceWriter(TraceWriter *writer)
+{
+    if (writer->file != NULL)
+    {
+        if (writer->buffer != NULL)
+        {
+            flushTraceWriter(writer);
+        }
+        fclose(writer->file);
+        writer->file = NULL;
+    }
+    free(writer->buffer);
+    writer->buffer = NULL;
+    writer->used = 0;
+}
+
+#ifdef _WIN32
+bool mapFile(MappedFile *mapped, const char *path, size_t minimumSize)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)minimumSize)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    mapped->view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapped->view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    mapped->size = (size_t)size.QuadPart;
+    mapped->mapping = mapping;
+    mapped->file = file;
+    return true;
+}
+
+bool remapFile(MappedFile *mapped)
+{
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx((HANDLE)mapped->file, &size) || (size_t)size.QuadPart <= mapped->size)
+    {
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA((HANDLE)mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    UnmapViewOfFile(mapped->view);
+    CloseHandle((HANDLE)mapped->mapping);
+    mapped->view = view;
+    mapped->size = (size_t)size.QuadPart;
+    mapped->mapping = mapping;
+    return true;
+}
+
+void unmapFile(MappedFile *mapped)
+{
+    if (mapped->view != NULL)
+    {
+        UnmapViewOfFile(mapped->view);
+        CloseHandle((HANDLE)mapped->mapping);
+        CloseHandle((HANDLE)mapped->file);
+    }
+    memset(mapped, 0, sizeof(MappedFile));
+}
+#else
+bool mapFile(MappedFile *mapped, const char *path, size_t minimumSize)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)minimumSize)
+    {
+        close(fd);
+        return false;
+    }
+    void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    // Mapped files are consumed front to back, so let the kernel read ahead aggressively
+    madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+    mapped->view = view;
+    mapped->size = (size_t)info.st_size;
+    mapped->file = (void *)(intptr_t)fd; // Kept open so remapFile can see the file grow
+    return true;
+}
+
+bool remapFile(MappedFile *mapped)
+{
+    int fd = (int)(intptr_t)mapped->file;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size <= mapped->size)
+    {
+        return false;
+    }
+    void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+    munmap(mapped->view, mapped->size);
+    mapped->view = view;
+    mapped->size = (size_t)info.st_size;
+    return true;
+}
+
+void unmapFile(MappedFile *mapped)
+{
+    if (mapped->view != NULL)
+    {
+        munmap(mapped->view, mapped->size);
+        close((int)(intptr_t)mapped->file);
+    }
+    memset(mapped, 0, sizeof(MappedFile));
+}
+#endif
+
+// Maps a trace into memory and validates its header. Nothing is parsed or
+// copied; pages are faulted in as the records are consumed.
+bool openTraceReader(TraceReader *reader, const char *path)
+{
+    memset(reader, 0, sizeof(TraceReader));
+    if (!mapFile(&reader->file, path, sizeof(TraceHeader)))
+    {
+        return false;
+    }
+
+    const TraceHeader *header = (const TraceHeader *)reader->file.view;
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION || header->recordSize != sizeof(SpawnRecord))
+    {
+        closeTraceReader(reader);
+        return false;
+    }
+    reader->records = (const SpawnRecord *)((const char *)reader->file.view + sizeof(TraceHeader));
+    reader->count = (reader->file.size - sizeof(TraceHeader)) / sizeof(SpawnRecord);
+    reader->next = 0;
+    return true;
+}
+
+// Maps the trace again if it has grown since it was last mapped, so records a
+// generator appended since then can be read. A record still being written is
+// left for a later refresh. Returns whether new records became readable.
+bool refreshTraceReader(TraceReader *reader)
+{
+    Uint64 count = reader->count;
+    if (!remapFile(&reader->file))
+    {
+        return false;
+    }
+    reader->records = (const SpawnRecord *)((const char *)reader->file.view + sizeof(TraceHeader));
+    reader->count = (reader->file.size - sizeof(TraceHeader)) / sizeof(SpawnRecord);
+    return reader->count > count;
+}
+
+void closeTraceReader(TraceReader *reader)
+{
+    unmapFile(&reader->file);
+    memset(reader, 0, sizeof(TraceReader));
+}
@@ -0,0 +1,65 @@
+#ifndef VEHICLE_TRACE_H
+#define VEHICLE_TRACE_H
+
+#include <stdio.h>
+#include "traffic_simulation.h"
+
+// Binary arrival trace: a TraceHeader followed by packed SpawnRecords in
+// timestamp order, all little-endian. The record count is implied by the file
+// size, so a trace can be appended to while it is being read; refreshTraceReader
+// picks up the new records.
+#define TRACE_MAGIC 0x43525454 // "TTRC"
+#define TRACE_VERSION 1
+#define TRACE_WRITE_BUFFER_SIZE (1 << 20) // Bytes handed to the OS per write
+
+typedef struct {
+    Uint32 magic;
+    Uint16 version;
+    Uint16 recordSize;
+    Uint64 reserved;
+} TraceHeader;
+
+SDL_COMPILE_TIME_ASSERT(traceHeaderSize, sizeof(TraceHeader) == 16);
+SDL_COMPILE_TIME_ASSERT(spawnRecordSize, sizeof(SpawnRecord) == 8);
+
+// Buffered writer; the header shares the first buffer. Unless flushTraceWriter
+// is called early, every write except the last is a full TRACE_WRITE_BUFFER_SIZE
+// block at an aligned file offset.
+typedef struct {
+    FILE* file;
+    char* buffer;
+    size_t used;
+} TraceWriter;
+
+// A whole file mapped read-only into memory
+typedef struct {
+    void* view;
+    size_t size;
+    void* mapping; // Platform handles of the mapped file; on POSIX, file holds the descriptor
+    void* file;
+} MappedFile;
+
+// Read-only view of a memory-mapped trace; records point straight into the mapping
+typedef struct {
+    const SpawnRecord* records;
+    Uint64 count;
+    Uint64 next;
+    MappedFile file;
+} TraceReader;
+
+bool openTraceWriter(TraceWriter* writer, const char* path);
+bool writeTraceRecords(TraceWriter* writer, const SpawnRecord* records, size_t count);
+bool flushTraceWriter(TraceWriter* writer);
+void closeTraceWriter(TraceWriter* writer);
+
+// Maps a whole file read-only; fails if it is shorter than minimumSize bytes
+bool mapFile(MappedFile* file, const char* path, size_t minimumSize);
+// Maps the file again if it has grown; returns false if it has not or remapping failed
+bool remapFile(MappedFile* file);
+void unmapFile(MappedFile* file);
+
+bool openTraceReader(TraceReader* reader, const char* path);
+bool refreshTraceReader(TraceReader* reader);
+void closeTraceReader(TraceReader* reader);
+
+#endif
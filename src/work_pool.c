@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include "work_pool.h"
+
+#define WORK_RANGE_SIZE 64 // One cache line per range, so workers do not false-share
+
+// The tasks [next, end) still owned by one worker
+typedef struct {
+    SDL_SpinLock lock;
+    int next;
+    int end;
+    char padding[WORK_RANGE_SIZE - sizeof(SDL_SpinLock) - 2 * sizeof(int)];
+} WorkRange;
+
+typedef struct {
+    WorkRange *ranges;
+    int workerCount;
+    WorkFunction function;
+    void *context;
+} WorkPool;
+
+typedef struct {
+    WorkPool *pool;
+    int index;
+} Worker;
+
+int defaultWorkerCount(void)
+{
+    int count = SDL_GetCPUCount();
+    return (count > 0) ? count : 1;
+}
+
+// Takes the next task from the worker's own range, or returns -1 if it is empty
+static int takeTask(WorkRange *range)
+{
+    int task = -1;
+    SDL_AtomicLock(&range->lock);
+    if (range->next < range->end)
+    {
+        task = range->next++;
+    }
+    SDL_AtomicUnlock(&range->lock);
+    return task;
+}
+
+// Moves the back half of the fullest other range into the thief's own range.
+// Returns false once no other worker has tasks left.
+static bool stealTasks(WorkPool *pool, int thief)
+{
+    for (;;)
+    {
+        // Pick a victim without locking; the choice is rechecked under its lock
+        int victim = -1;
+        int most = 0;
+        for (int i = 1; i < pool->workerCount; i++)
+        {
+            int candidate = (thief + i) % pool->workerCount;
+            int remaining = pool->ranges[candidate].end - pool->ranges[candidate].next;
+            if (remaining > most)
+            {
+                most = remaining;
+                victim = candidate;
+            }
+        }
+        if (victim < 0)
+        {
+            return false;
+        }
+
+        WorkRange *range = &pool->ranges[victim];
+        int first = 0;
+        int end = 0;
+        SDL_AtomicLock(&range->lock);
+        int remaining = range->end - range->next;
+        if (remaining > 0)
+        {
+            // Leave the victim the front half, which it is about to work through
+            first = range->next + remaining / 2;
+            end = range->end;
+            range->end = first;
+        }
+        SDL_AtomicUnlock(&range->lock);
+
+        if (first < end)
+        {
+            WorkRange *own = &pool->ranges[thief];
+            SDL_AtomicLock(&own->lock);
+            own->next = first;
+            own->end = end;
+            SDL_AtomicUnlock(&own->lock);
+            return true;
+        }
+    }
+}
+
+static int runWorker(void *data)
+{
+    Worker *worker = (Worker *)data;
+    WorkPool *pool = worker->pool;
+    for (;;)
+    {
+        int task = takeTask(&pool->ranges[worker->index]);
+        if (task >= 0)
+        {
+            pool->function(pool->context, task);
+        }
+        else if (!stealTasks(pool, worker->index))
+        {
+            return 0;
+        }
+    }
+}
+
+// Calls function(context, task) once for every task in [0, taskCount) and
+// returns when all of them have finished. The calling thread is one of the workers.
+void runWorkPool(int taskCount, int workerCount, WorkFunction function, void *context)
+{
+    if (workerCount > taskCount)
+    {
+        workerCount = taskCount;
+    }
+    if (workerCount < 1)
+    {
+        workerCount = 1;
+    }
+
+    WorkPool pool;
+    pool.ranges = (WorkRange *)calloc(workerCount, sizeof(WorkRange));
+    pool.workerCount = workerCount;
+    pool.function = function;
+    pool.context = context;
+    Worker *workers = (Worker *)malloc(workerCount * sizeof(Worker));
+    SDL_Thread **threads = (SDL_Thread **)malloc(workerCount * sizeof(SDL_Thread *));
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        pool.ranges[i].next = (int)((Sint64)taskCount * i / workerCount);
+        pool.ranges[i].end = (int)((Sint64)taskCount * (i + 1) / workerCount);
+        workers[i].pool = &pool;
+        workers[i].index = i;
+    }
+
+    for (int i = 1; i < workerCount; i++)
+    {
+        threads[i] = SDL_CreateThread(runWorker, "work pool", &workers[i]);
+    }
+    runWorker(&workers[0]);
+    for (int i = 1; i < workerCount; i++)
+    {
+        if (threads[i] != NULL)
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+
+    // A worker that failed to start still has its tasks, so run what is left here
+    for (int i = 1; i < workerCount; i++)
+    {
+        if (threads[i] == NULL)
+        {
+            int task;
+            while ((task = takeTask(&pool.ranges[i])) >= 0)
+            {
+                function(context, task);
+            }
+        }
+    }
+
+    free(threads);
+    free(workers);
+    free(pool.ranges);
+}
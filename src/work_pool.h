@@ -0,0 +1,15 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <SDL.h>
+
+// Runs a fixed set of independent tasks across a pool of threads. Every worker
+// starts with a contiguous block of task indices and takes from its front;
+// a worker that runs dry steals the back half of the fullest remaining block,
+// so uneven task lengths still keep every thread busy.
+typedef void (*WorkFunction)(void* context, int task);
+
+int defaultWorkerCount(void);
+void runWorkPool(int taskCount, int workerCount, WorkFunction function, void* context);
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/snapshot.h"
+
+// Checks that snapshots are deterministic and that restoring rejects
+// inconsistent ones. Exits with a non-zero status on the first failure.
+
+#define SEED 7
+#define DURATION_MS (600 * 1000)
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Leaves freed blocks full of garbage behind, so any uninitialized memory
+// that reaches a snapshot differs between runs
+static void scribbleHeap(void) {
+    enum { BLOCKS_PER_SIZE = 8 };
+    for (size_t size = 16; size <= 16 * 1024; size += 16) {
+        void *blocks[BLOCKS_PER_SIZE];
+        for (int i = 0; i < BLOCKS_PER_SIZE; i++) {
+            blocks[i] = malloc(size);
+            memset(blocks[i], 0xA5, size);
+        }
+        for (int i = 0; i < BLOCKS_PER_SIZE; i++) {
+            free(blocks[i]);
+        }
+    }
+}
+
+// Runs a low-demand day from an empty intersection, so the vehicle store
+// grows and then mostly empties again
+static void runDay(Simulation *sim, ArrivalProcess *arrivals) {
+    ArrivalConfig config;
+    defaultArrivalConfig(&config);
+    for (int i = 0; i < 4; i++) {
+        config.vehiclesPerMinute[i] = 3.0f;
+    }
+    initSimulation(sim, DEFAULT_MAX_VEHICLES, SIMULATION_TICK_MS);
+    sim->quiet = true;
+    initArrivalProcess(arrivals, &config, SEED);
+    while (sim->clock.now < DURATION_MS) {
+        drainArrivals(arrivals, sim, sim->clock.now);
+        simulationStep(sim, NULL);
+    }
+}
+
+static void *takeSnapshot(const SimulationState *state, size_t *size) {
+    *size = snapshotSize(state);
+    void *buffer = malloc(*size);
+    check(writeSnapshot(state, buffer, *size) == *size, "snapshot fits its measured size");
+    return buffer;
+}
+
+static bool sameSnapshots(const void *a, size_t aSize, const void *b, size_t bSize) {
+    return aSize == bSize && memcmp(a, b, aSize) == 0;
+}
+
+// Snapshots a deliberately broken state and checks that restoring it fails
+// and leaves the target untouched
+static void checkRejected(SimulationState *broken, SimulationState *target, const char *what) {
+    size_t size;
+    void *buffer = takeSnapshot(broken, &size);
+    int count = target->simulation->vehicles.count;
+    Uint32 now = target->simulation->clock.now;
+    check(!restoreSnapshot(target, buffer, size), what);
+    check(target->simulation->vehicles.count == count && target->simulation->clock.now == now,
+          "a rejected snapshot leaves the state unchanged");
+    free(buffer);
+}
+
+int main(void) {
+    Simulation first, second, restored;
+    ArrivalProcess firstArrivals, secondArrivals, restoredArrivals;
+    SimulationState firstState = {&first, &firstArrivals};
+    SimulationState secondState = {&second, &secondArrivals};
+    SimulationState restoredState = {&restored, &restoredArrivals};
+
+    runDay(&first, &firstArrivals);
+    scribbleHeap();
+    runDay(&second, &secondArrivals);
+
+    size_t firstSize, againSize, secondSize, restoredSize;
+    void *firstSnapshot = takeSnapshot(&firstState, &firstSize);
+    void *againSnapshot = takeSnapshot(&firstState, &againSize);
+    void *secondSnapshot = takeSnapshot(&secondState, &secondSize);
+    check(sameSnapshots(firstSnapshot, firstSize, againSnapshot, againSize),
+          "saving the same state twice gives the same bytes");
+    check(sameSnapshots(firstSnapshot, firstSize, secondSnapshot, secondSize),
+          "two identical runs give the same bytes");
+
+    initSimulation(&restored, DEFAULT_MAX_VEHICLES, SIMULATION_TICK_MS);
+    restored.quiet = true;
+    check(restoreSnapshot(&restoredState, firstSnapshot, firstSize), "a saved snapshot restores");
+    void *restoredSnapshot = takeSnapshot(&restoredState, &restoredSize);
+    check(sameSnapshots(firstSnapshot, firstSize, restoredSnapshot, restoredSize),
+          "a restored state saves the same bytes");
+
+    // Corrupt copies of the second run; each must be rejected
+    VehicleStore *store = &second.vehicles;
+    check(store->count > 0 && store->freeCount > 1, "the run ends with active and free vehicles");
+    int id = store->ids[0];
+    store->ids[0] = store->capacity;
+    checkRejected(&secondState, &restoredState, "an out-of-range vehicle id is rejected");
+    store->ids[0] = id;
+
+    int freeId = store->freeIds[0];
+    store->freeIds[0] = store->freeIds[1];
+    checkRejected(&secondState, &restoredState, "a duplicate free id is rejected");
+    store->freeIds[0] = freeId;
+
+    store->freeCount--;
+    checkRejected(&secondState, &restoredState, "an id that is neither active nor free is rejected");
+    store->freeCount++;
+
+    Direction direction = store->direction[0];
+    store->direction[0] = (Direction)7;
+    checkRejected(&secondState, &restoredState, "an out-of-range direction is rejected");
+    store->direction[0] = direction;
+
+    int queueCapacity = second.laneQueues[0].capacity;
+    second.laneQueues[0].capacity = QUEUE_MAX_CAPACITY + 1;
+    checkRejected(&secondState, &restoredState, "an oversized lane queue is rejected");
+    second.laneQueues[0].capacity = queueCapacity;
+
+    free(firstSnapshot);
+    free(againSnapshot);
+    free(secondSnapshot);
+    free(restoredSnapshot);
+    freeSimulation(&first);
+    freeSimulation(&second);
+    freeSimulation(&restored);
+
+    if (failures == 0) {
+        printf("All snapshot checks passed\n");
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/traffic_simulation.h"
+
+// Drives one vehicle through every turn from every approach and checks that it
+// comes out heading the right way, exactly on the exit approach's through lane.
+// Exits with a non-zero status on the first failure.
+
+#define MAX_TICKS 10000
+
+static const char *DIRECTION_NAMES[] = {"north", "south", "east", "west"};
+static const Direction LEFT_EXITS[] = {DIRECTION_WEST, DIRECTION_EAST, DIRECTION_NORTH, DIRECTION_SOUTH};
+static const Direction RIGHT_EXITS[] = {DIRECTION_EAST, DIRECTION_WEST, DIRECTION_SOUTH, DIRECTION_NORTH};
+
+static int failures = 0;
+
+static bool northSouth(Direction direction) {
+    return direction == DIRECTION_NORTH || direction == DIRECTION_SOUTH;
+}
+
+// Across-road position of a vehicle in the given lane: x on the north-south
+// road, y on the east-west road
+static float acrossRoad(Direction direction, float x, float y) {
+    return northSouth(direction) ? x : y;
+}
+
+static void checkTurn(Direction direction, TurnDirection turn) {
+    const char *turnName = (turn == TURN_LEFT) ? "left" : "right";
+    Direction exit = (turn == TURN_LEFT) ? LEFT_EXITS[direction] : RIGHT_EXITS[direction];
+
+    // A through vehicle spawned on the exit approach marks the lane to end in
+    Vehicle through;
+    setupVehicle(&through, exit, REGULAR_CAR, TURN_NONE);
+    float exitLane = acrossRoad(exit, through.x, through.y);
+
+    Simulation sim;
+    initSimulation(&sim, DEFAULT_MAX_VEHICLES, SIMULATION_TICK_MS);
+    sim.quiet = true;
+    SpawnRecord record = {0, (Uint8)direction, REGULAR_CAR, (Uint8)turn, 0};
+    int index = spawnVehicleFromRecord(&sim, &record);
+    // Ignore the lights; only the path matters here
+    sim.vehicles.canSkipLight[index] = true;
+
+    VehicleStore *store = &sim.vehicles;
+    int ticks = 0;
+    while (store->count == 1 && store->turnDirection[0] != TURN_NONE && ticks < MAX_TICKS) {
+        simulationStep(&sim, NULL);
+        ticks++;
+    }
+
+    if (store->count != 1 || store->turnDirection[0] != TURN_NONE) {
+        printf("FAIL: %s %s turn never completed\n", DIRECTION_NAMES[direction], turnName);
+        failures++;
+    } else if (store->direction[0] != exit) {
+        printf("FAIL: %s %s turn heads %s, expected %s\n", DIRECTION_NAMES[direction], turnName,
+               DIRECTION_NAMES[store->direction[0]], DIRECTION_NAMES[exit]);
+        failures++;
+    } else if (acrossRoad(exit, store->x[0], store->y[0]) != exitLane) {
+        printf("FAIL: %s %s turn ends at (%.2f, %.2f), off the %s lane at %.2f\n",
+               DIRECTION_NAMES[direction], turnName, store->x[0], store->y[0], DIRECTION_NAMES[exit], exitLane);
+        failures++;
+    }
+    freeSimulation(&sim);
+}
+
+int main(void) {
+    for (int direction = 0; direction < 4; direction++) {
+        checkTurn((Direction)direction, TURN_LEFT);
+        checkTurn((Direction)direction, TURN_RIGHT);
+    }
+
+    if (failures == 0) {
+        printf("All turn checks passed\n");
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}